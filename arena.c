@@ -0,0 +1,136 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Bump pointer arena for the cJSON fallback parser.
+ *
+ * Between arena_begin() and arena_end() every allocation cJSON makes
+ * is carved out of one preallocated block, and frees do nothing;
+ * arena_end() releases the whole message at once by resetting the
+ * pointer, so there is no need to call cJSON_Delete() in the scope.
+ * When a line is too large for the block, further allocations fall
+ * back to malloc() and are freed by arena_end() as well.
+ *
+ * The hooks are global to cJSON, so only one thread may parse at a
+ * time and nothing allocated in a scope may outlive it.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+#include "cJSON.h"
+
+#define ARENA_ALIGN	16
+
+/* Header in front of each heap fallback block */
+struct fallback {
+	struct fallback *next;
+	size_t size;
+} __attribute__((aligned(ARENA_ALIGN)));
+
+static char *arena;
+static size_t arena_size;
+static size_t arena_used;
+static struct fallback *fallbacks;
+static size_t fallback_bytes;
+static struct arena_stats stats;
+
+static void *arena_malloc(size_t size)
+{
+	struct fallback *fb;
+	size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (need <= arena_size - arena_used) {
+		void *p = arena + arena_used;
+		arena_used += need;
+		return p;
+	}
+
+	fb = (struct fallback *)malloc(sizeof(struct fallback) + size);
+	if (fb == NULL)
+		return NULL;
+	fb->next = fallbacks;
+	fb->size = size;
+	fallbacks = fb;
+	fallback_bytes += size;
+	stats.fallbacks++;
+
+	return fb + 1;
+}
+
+static void arena_free(void *p)
+{
+	/* Everything is released by arena_end() */
+	(void)p;
+}
+
+static cJSON_Hooks arena_hooks = { arena_malloc, arena_free };
+
+int arena_init(size_t size)
+{
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	arena = (char *)aligned_alloc(ARENA_ALIGN, size);
+	if (arena == NULL)
+		return -1;
+
+	arena_size = size;
+	stats.size = arena_size;
+	return 0;
+}
+
+/*
+ * Route cJSON allocations into the arena until arena_end().
+ */
+void arena_begin(void)
+{
+	arena_used = 0;
+	fallback_bytes = 0;
+	stats.scopes++;
+	cJSON_InitHooks(&arena_hooks);
+}
+
+/*
+ * Free everything allocated since arena_begin() and give cJSON the
+ * normal heap back.
+ */
+void arena_end(void)
+{
+	struct fallback *fb;
+
+	cJSON_InitHooks(NULL);
+
+	if (arena_used > stats.peak)
+		stats.peak = arena_used;
+	if (fallback_bytes > stats.fallback_peak)
+		stats.fallback_peak = fallback_bytes;
+
+	while (fallbacks) {
+		fb = fallbacks;
+		fallbacks = fb->next;
+		free(fb);
+	}
+	arena_used = 0;
+	fallback_bytes = 0;
+}
+
+void arena_get_stats(struct arena_stats *st)
+{
+	*st = stats;
+}
@@ -0,0 +1,44 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Bump pointer arena for the cJSON fallback parser.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_SIZE	(32 * 1024)
+
+struct arena_stats {
+	size_t size;		/* arena capacity */
+	size_t peak;		/* most arena bytes used by one message */
+	unsigned long scopes;	/* messages parsed in the arena */
+	unsigned long fallbacks;	/* allocations that went to the heap */
+	size_t fallback_peak;	/* most heap bytes used by one message */
+};
+
+int arena_init(size_t size);
+void arena_begin(void);
+void arena_end(void);
+void arena_get_stats(struct arena_stats *stats);
+
+#endif
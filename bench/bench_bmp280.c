@@ -0,0 +1,169 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * BMP280 compensation: checks the integer formulas against the double
+ * ones over a sweep of raw ADC values, then times both.  Uses the
+ * datasheet's example calibration unless 12 trimming words are given
+ * on the command line (T1 T2 T3 P1 ... P9).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+#include "../bmp280.h"
+
+int debug = 0;
+
+/* Datasheet section 3.12, example */
+static struct bmp280_calibration cal = {
+	.T1 = 27504, .T2 = 26435, .T3 = -1000,
+	.P1 = 36477, .P2 = -10685, .P3 = 3024, .P4 = 2855, .P5 = 140,
+	.P6 = -7, .P7 = 15500, .P8 = -14600, .P9 = 6000,
+};
+
+#define ADC_T_MIN	400000	/* about -13 C with the example calibration */
+#define ADC_T_MAX	640000	/* about 63 C */
+#define ADC_P_MIN	350000	/* about 1120 hPa at 25 C */
+#define ADC_P_MAX	830000	/* about 300 hPa */
+#define ADC_STEP	997
+
+#define TEMP_TOLERANCE	0.01	/* C, the integer resolution */
+#define PRES_TOLERANCE	1.0	/* Pa */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	int32_t adc_t, adc_p, t_fine;
+	double t_fine_d, t_i, t_d, p_i, p_d;
+	double dt, dp, max_dt = 0, max_dp = 0;
+	unsigned long samples = 0, bad = 0, n;
+	unsigned long long c0, c_int, c_double;
+	double t0, s_int, s_double;
+	volatile double sink = 0;
+	volatile uint32_t isink = 0;
+	int rounds, r;
+
+	if (argc > 12) {
+		cal.T1 = atoi(argv[1]);
+		cal.T2 = atoi(argv[2]);
+		cal.T3 = atoi(argv[3]);
+		cal.P1 = atoi(argv[4]);
+		cal.P2 = atoi(argv[5]);
+		cal.P3 = atoi(argv[6]);
+		cal.P4 = atoi(argv[7]);
+		cal.P5 = atoi(argv[8]);
+		cal.P6 = atoi(argv[9]);
+		cal.P7 = atoi(argv[10]);
+		cal.P8 = atoi(argv[11]);
+		cal.P9 = atoi(argv[12]);
+	}
+
+	/* The datasheet's worked example: 25.08 C and 100653.27 Pa */
+	t_i = bmp280_temp_int(&cal, 519888, &t_fine) / 100.0;
+	p_i = bmp280_pressure_int(&cal, 415148, t_fine) / 256.0;
+	printf("example: %.2f C %.2f Pa\n", t_i, p_i);
+
+	/* Check the two agree */
+	for (adc_t = ADC_T_MIN; adc_t <= ADC_T_MAX; adc_t += ADC_STEP) {
+		t_i = bmp280_temp_int(&cal, adc_t, &t_fine) / 100.0;
+		t_d = bmp280_temp_double(&cal, adc_t, &t_fine_d);
+		dt = fabs(t_i - t_d);
+		if (dt > max_dt)
+			max_dt = dt;
+
+		for (adc_p = ADC_P_MIN; adc_p <= ADC_P_MAX; adc_p += ADC_STEP) {
+			p_i = bmp280_pressure_int(&cal, adc_p, t_fine) / 256.0;
+			p_d = bmp280_pressure_double(&cal, adc_p, t_fine_d);
+			dp = fabs(p_i - p_d);
+			if (dp > max_dp)
+				max_dp = dp;
+			if (dt > TEMP_TOLERANCE || dp > PRES_TOLERANCE) {
+				if (bad++ < 10)
+					printf("mismatch: adc_t %d adc_p %d: "
+							"%.2f/%.4f C %.3f/%.3f Pa\n",
+							adc_t, adc_p, t_i, t_d, p_i, p_d);
+			}
+			samples++;
+		}
+	}
+
+	printf("%lu samples, %lu outside tolerance, max error %.4f C %.4f Pa\n",
+			samples, bad, max_dt, max_dp);
+
+	/* Time them, one temperature and one pressure per sample */
+	rounds = (argc == 2) ? atoi(argv[1]) : 20;
+	n = 0;
+
+	t0 = now();
+	c0 = cycles();
+	for (r = 0; r < rounds; r++) {
+		for (adc_t = ADC_T_MIN; adc_t <= ADC_T_MAX; adc_t += ADC_STEP) {
+			adc_p = ADC_P_MIN + (adc_t * 7) % (ADC_P_MAX - ADC_P_MIN);
+			isink += bmp280_temp_int(&cal, adc_t, &t_fine);
+			isink += bmp280_pressure_int(&cal, adc_p, t_fine);
+			n++;
+		}
+	}
+	c_int = cycles() - c0;
+	s_int = now() - t0;
+
+	t0 = now();
+	c0 = cycles();
+	for (r = 0; r < rounds; r++) {
+		for (adc_t = ADC_T_MIN; adc_t <= ADC_T_MAX; adc_t += ADC_STEP) {
+			adc_p = ADC_P_MIN + (adc_t * 7) % (ADC_P_MAX - ADC_P_MIN);
+			sink += bmp280_temp_double(&cal, adc_t, &t_fine_d);
+			sink += bmp280_pressure_double(&cal, adc_p, t_fine_d);
+		}
+	}
+	c_double = cycles() - c0;
+	s_double = now() - t0;
+
+	printf("integer: %8.1f ns/sample", s_int * 1e9 / n);
+	if (c_int)
+		printf(" %8.1f cycles/sample", (double)c_int / n);
+	printf("\ndouble:  %8.1f ns/sample", s_double * 1e9 / n);
+	if (c_double)
+		printf(" %8.1f cycles/sample", (double)c_double / n);
+	printf("\nspeedup: %8.1fx\n", s_double / s_int);
+
+	return bad ? 1 : 0;
+}
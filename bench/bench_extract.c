@@ -0,0 +1,284 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Throughput of the single pass extractor against cJSON_Parse plus
+ * lookups on a corpus of rtl_433 lines.  The corpus can be plain
+ * rtl_433 output or a capture from --record; capture records are
+ * unwrapped by the replay reader.  Without one, a corpus shaped like a
+ * suburban 433 MHz band is made up: 5-in-1 and tower transmissions in
+ * threes, single thermometer messages and the neighbours' devices that
+ * rtl2udp ignores, with signal levels on some of them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../cJSON.h"
+#include "../extract.h"
+#include "../replay.h"
+
+#define SYNTH_LINES	20000
+#define SYNTH_MAXLINE	512
+
+struct line {
+	const char *p;
+	size_t len;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int same_str(const char *a, size_t alen, const char *b, size_t blen)
+{
+	return alen == blen && (alen == 0 || memcmp(a, b, alen) == 0);
+}
+
+static int same_msg(const struct rtl_msg *a, const struct rtl_msg *b)
+{
+	int i;
+
+	if (a->present != b->present)
+		return 0;
+
+	for (i = 0; i < FIELD_COUNT; i++) {
+		if (a->num[i] != b->num[i] ||
+				(a->str[i].p == NULL) != (b->str[i].p == NULL) ||
+				!same_str(a->str[i].p, a->str[i].len,
+					b->str[i].p, b->str[i].len))
+			return 0;
+	}
+
+	return 1;
+}
+
+static const char *dirs[] = {
+	"N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE",
+	"S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW",
+};
+
+static double frand(double lo, double hi)
+{
+	return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+/* Signal levels, as rtl_433 -M level adds them */
+static int put_level(char *p, size_t n)
+{
+	if (rand() % 2)
+		return 0;
+	return snprintf(p, n, ", \"mod\" : \"ASK\", \"freq\" : %.3f, "
+			"\"rssi\" : %.3f, \"snr\" : %.3f, \"noise\" : %.3f",
+			frand(433.85, 433.99), frand(-12, -0.1), frand(5, 30),
+			frand(-30, -15));
+}
+
+/* One transmission, which may be repeated; returns the lines written */
+static int synth_transmission(char *buf, int t)
+{
+	char *p = buf;
+	int i, n, len, repeats = 1, kind = rand() % 20;
+	int sec = t % 60, min = t / 60 % 60;
+	int type = rand() % 2 ? 56 : 49;
+	double wind = frand(0, 12), dir = (rand() % 16) * 22.5;
+
+	if (kind < 11)
+		repeats = 3;
+	for (i = 0; i < repeats; i++) {
+		len = SYNTH_MAXLINE - 152;
+		if (kind < 8 && type == 56) {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"Acurite 5n1 sensor\", \"sensor_id\" : 1234, "
+					"\"channel\" : \"A\", \"sequence_num\" : %d, "
+					"\"battery\" : \"OK\", \"message_type\" : 56, "
+					"\"wind_speed_mph\" : %.3f, \"temperature_F\" : %.3f, "
+					"\"humidity\" : %d", min, sec, i, wind,
+					frand(20, 95), rand() % 80 + 20);
+		} else if (kind < 8) {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"Acurite 5n1 sensor\", \"sensor_id\" : 1234, "
+					"\"channel\" : \"A\", \"sequence_num\" : %d, "
+					"\"battery\" : \"OK\", \"message_type\" : 49, "
+					"\"wind_speed_mph\" : %.3f, \"wind_dir_deg\" : %.3f, "
+					"\"wind_dir\" : \"%s\", "
+					"\"rainfall_accumulation_inch\" : %.3f, "
+					"\"raincounter_raw\" : %d", min, sec, i, wind, dir,
+					dirs[(int)(dir / 22.5)], frand(0, 2), rand() % 200);
+		} else if (kind < 11) {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"Acurite tower sensor\", \"id\" : %d, "
+					"\"sensor_id\" : %d, \"channel\" : \"C\", "
+					"\"temperature_C\" : %.3f, \"humidity\" : %d, "
+					"\"battery\" : 0", min, sec, 5555 + kind,
+					5555 + kind, frand(-10, 35), rand() % 80 + 20);
+		} else if (kind < 14) {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"LaCrosse-TX141THBv2\", \"id\" : %d, "
+					"\"channel\" : 0, \"battery_ok\" : 1, "
+					"\"temperature_C\" : %.3f, \"humidity\" : %d, "
+					"\"test\" : \"No\", \"mic\" : \"CRC\"", min, sec,
+					rand() % 256, frand(-10, 35), rand() % 80 + 20);
+		} else if (kind < 17) {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"Toyota\", \"type\" : \"TPMS\", "
+					"\"id\" : \"%08x\", \"status\" : %d, "
+					"\"pressure_PSI\" : %.3f, \"temperature_C\" : %.3f, "
+					"\"mic\" : \"CRC\"", min, sec, rand(), rand() % 256,
+					frand(28, 36), frand(5, 40));
+		} else {
+			n = snprintf(p, len, "{\"time\" : \"2024-05-01 10:%02d:%02d\", "
+					"\"model\" : \"Honeywell-Security\", \"id\" : %d, "
+					"\"channel\" : 8, \"event\" : %d, \"state\" : \"%s\", "
+					"\"contact_open\" : %d, \"reed_open\" : 0, "
+					"\"alarm\" : 0, \"tamper\" : 0, \"battery_ok\" : 1, "
+					"\"heartbeat\" : 1", min, sec, rand() % 1000000,
+					rand() % 256, rand() % 2 ? "open" : "closed",
+					rand() % 2);
+		}
+		p += n;
+		p += put_level(p, 150);
+		*p++ = '}';
+		*p++ = '\n';
+	}
+	*p = '\0';
+
+	return p - buf;
+}
+
+static char *synth_corpus(size_t *size)
+{
+	char *buf, *p;
+	int t = 0;
+
+	buf = malloc((size_t)SYNTH_LINES * SYNTH_MAXLINE);
+	if (buf == NULL)
+		return NULL;
+
+	srand(1);
+	for (p = buf; p - buf < (long)(SYNTH_LINES - 3) * SYNTH_MAXLINE / 2; t += 5)
+		p += synth_transmission(p, t);
+	*size = p - buf;
+
+	return buf;
+}
+
+int main(int argc, char **argv)
+{
+	struct line *lines;
+	size_t nlines = 0, i, size;
+	char *corpus = NULL, *p, *nl;
+	struct replay rp;
+	struct replay_rec rec;
+	struct rtl_msg a, b;
+	cJSON *json;
+	int rounds, r;
+	unsigned long rejected = 0, mismatched = 0;
+	double t0, t_cjson, t_extract, bytes = 0;
+
+	if (argc > 1) {
+		if (replay_open(&rp, argv[1]) < 0)
+			return 1;
+		lines = malloc(sizeof(struct line) * (rp.size / 2 + 1));
+		while (replay_next(&rp, &rec)) {
+			lines[nlines].p = rec.line;
+			lines[nlines].len = rec.len;
+			nlines++;
+		}
+	} else {
+		corpus = synth_corpus(&size);
+		if (corpus == NULL)
+			return 1;
+		lines = malloc(sizeof(struct line) * (size / 2 + 1));
+		for (p = corpus; p < corpus + size; p = nl + 1) {
+			nl = memchr(p, '\n', corpus + size - p);
+			if (nl == NULL)
+				nl = corpus + size;
+			if (nl > p) {
+				lines[nlines].p = p;
+				lines[nlines].len = nl - p;
+				nlines++;
+			}
+		}
+	}
+
+	if (nlines == 0)
+		return 1;
+
+	/* Check both paths agree on every line the extractor accepts */
+	for (i = 0; i < nlines; i++) {
+		bytes += lines[i].len;
+		json = cJSON_ParseWithLength(lines[i].p, lines[i].len);
+		if (extract_line(lines[i].p, lines[i].len, &a) < 0) {
+			rejected++;
+		} else if (json) {
+			extract_from_cjson(json, &b);
+			if (!same_msg(&a, &b)) {
+				mismatched++;
+				printf("mismatch: %.*s\n", (int)lines[i].len,
+						lines[i].p);
+			}
+		}
+		cJSON_Delete(json);
+	}
+
+	rounds = (argc > 2) ? atoi(argv[2]) : (int)(400000 / nlines) + 1;
+
+	t0 = now();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nlines; i++) {
+			json = cJSON_ParseWithLength(lines[i].p, lines[i].len);
+			extract_from_cjson(json, &b);
+			cJSON_Delete(json);
+		}
+	}
+	t_cjson = now() - t0;
+
+	t0 = now();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nlines; i++) {
+			if (extract_line(lines[i].p, lines[i].len, &a) < 0) {
+				json = cJSON_ParseWithLength(lines[i].p, lines[i].len);
+				extract_from_cjson(json, &a);
+				cJSON_Delete(json);
+			}
+		}
+	}
+	t_extract = now() - t0;
+
+	printf("%zu lines, %lu rejected by the extractor, %lu mismatched\n",
+			nlines, rejected, mismatched);
+	printf("cJSON:     %10.0f lines/s %8.1f MB/s\n",
+			rounds * nlines / t_cjson, rounds * bytes / t_cjson / 1e6);
+	printf("extractor: %10.0f lines/s %8.1f MB/s\n",
+			rounds * nlines / t_extract, rounds * bytes / t_extract / 1e6);
+	printf("speedup:   %10.1fx\n", t_cjson / t_extract);
+
+	free(lines);
+	if (corpus)
+		free(corpus);
+	else
+		replay_close(&rp);
+	return mismatched ? 1 : 0;
+}
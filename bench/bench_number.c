@@ -0,0 +1,126 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Compare cJSON_PrintDouble() with the sprintf("%1.15g")/sscanf()/
+ * sprintf("%1.17g") sequence cJSON used to print numbers, on the kind
+ * of values that go into WeatherFlow packets.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../cJSON.h"
+
+#define NVALUES	4096
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int print_libc(double d, char *buf)
+{
+	double test;
+	int len;
+
+	len = sprintf(buf, "%1.15g", d);
+	if ((sscanf(buf, "%lg", &test) != 1) || (test != d))
+		len = sprintf(buf, "%1.17g", d);
+
+	return len;
+}
+
+int main(int argc, char **argv)
+{
+	static double values[NVALUES];
+	char a[32], b[32];
+	int i, r, rounds = (argc > 1) ? atoi(argv[1]) : 200;
+	int la, lb, same = 0, shorter = 0;
+	double t0, t_libc, t_fast;
+	size_t total = 0;
+
+	srand(1);
+	for (i = 0; i < NVALUES; i++) {
+		switch (i % 6) {
+			case 0:	/* epoch time, interval */
+				values[i] = 1539000000 + i;
+				break;
+			case 1:	/* temperature */
+				values[i] = round((((rand() % 1200) / 10.0 - 32) / 1.8) * 10) / 10;
+				break;
+			case 2:	/* station pressure */
+				values[i] = 950 + (rand() % 10000) / 100.0 + (rand() % 1000) / 1e7;
+				break;
+			case 3:	/* wind speed */
+				values[i] = round((rand() % 400) * .44704 * 10) / 10;
+				break;
+			case 4:	/* humidity, battery */
+				values[i] = rand() % 101;
+				break;
+			case 5:	/* raw arithmetic results */
+				values[i] = (rand() % 100000) / 7.0;
+				break;
+		}
+	}
+
+	for (i = 0; i < NVALUES; i++) {
+		la = cJSON_PrintDouble(values[i], a, sizeof(a));
+		lb = print_libc(values[i], b);
+		if (strtod(a, NULL) != values[i]) {
+			printf("%s does not round trip (%.17g)\n", a, values[i]);
+			return 1;
+		}
+		if (la > lb) {
+			printf("%s is longer than %s\n", a, b);
+			return 1;
+		}
+		if (strcmp(a, b) == 0)
+			same++;
+		else
+			shorter++;
+	}
+
+	t0 = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NVALUES; i++)
+			total += print_libc(values[i], b);
+	t_libc = now() - t0;
+
+	t0 = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NVALUES; i++)
+			total += cJSON_PrintDouble(values[i], a, sizeof(a));
+	t_fast = now() - t0;
+
+	printf("%d values: %d identical, %d shorter (%zu bytes)\n", NVALUES,
+			same, shorter, total);
+	printf("sprintf/sscanf:    %8.1f ns/number\n",
+			t_libc * 1e9 / ((double)rounds * NVALUES));
+	printf("cJSON_PrintDouble: %8.1f ns/number\n",
+			t_fast * 1e9 / ((double)rounds * NVALUES));
+	printf("speedup:           %8.1fx\n", t_libc / t_fast);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Predictive sampling against the simulated I2C bus: two sources
+ * transmitting on their own periods, with some jitter, while the
+ * predictor learns them, then both going quiet.  Reports how many
+ * arrivals found a refresh started for them, how far ahead it was
+ * started, and how many sensor reads that took.  Periods are scaled
+ * down from the Acurite ones so it finishes in seconds.  Runs without
+ * hardware.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "../sampler.h"
+#include "../predict.h"
+#include "../i2csim.h"
+#include "../evloop.h"
+
+int debug = 0;
+
+#define RUN_MS		15000
+#define JITTER_MS	10
+
+static const struct {
+	uint64_t key;
+	unsigned int kinds;
+	long period_ms;
+} sensors[] = {
+	{ 1, SAMPLE_BIT(SAMPLE_PRESSURE), 600 },
+	{ 2, SAMPLE_BIT(SAMPLE_LUX) | SAMPLE_BIT(SAMPLE_UV), 900 },
+};
+
+#define NSENSORS	(sizeof(sensors) / sizeof(sensors[0]))
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void sleep_until(long long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+}
+
+static void *loop_thread(void *arg)
+{
+	evloop_run();
+	return NULL;
+}
+
+static unsigned long reads(void)
+{
+	struct sampler_stats p, l;
+
+	sampler_get_stats(SAMPLE_PRESSURE, &p);
+	sampler_get_stats(SAMPLE_LUX, &l);
+	return p.refreshes + l.refreshes;
+}
+
+int main(int argc, char **argv)
+{
+	struct predict_stats st;
+	unsigned long missed;
+	long long next[NSENSORS], start, t;
+	pthread_t loop;
+	size_t i, first;
+
+	/* Daylight, so the TSL2561 settles on its shortest integration */
+	if (i2c_sim_attach("bus=1,latency=100,byte=23,"
+				"ch0=2000000,ch1=400000") == NULL ||
+			evloop_init() < 0 || sampler_add("bmp280:1") < 0 ||
+			sampler_add("tsl2561:1") < 0 || sampler_start(1) < 0 ||
+			predict_start() < 0 ||
+			pthread_create(&loop, NULL, loop_thread, NULL) != 0)
+		return 1;
+	srand(1);
+
+	/* Settle the light level and measure the latencies once */
+	sampler_refresh(sampler_provided(), -1);
+	sleep_until(now_ms() + 1000);
+
+	start = now_ms();
+	for (i = 0; i < NSENSORS; i++)
+		next[i] = start + sensors[i].period_ms * (i + 1) / 3;
+
+	for (;;) {
+		for (i = 0, first = 0; i < NSENSORS; i++) {
+			if (next[i] < next[first])
+				first = i;
+		}
+		if (next[first] > start + RUN_MS)
+			break;
+		t = next[first] + rand() % (2 * JITTER_MS + 1) - JITTER_MS;
+		sleep_until(t);
+		predict_arrival(sensors[first].key, sensors[first].kinds);
+		next[first] += sensors[first].period_ms;
+	}
+
+	predict_get_stats(&st);
+	printf("%lu arrivals from %d sensors, %lu prefetched, mean lead %lu ms\n",
+			st.arrivals, st.sources, st.prefetched,
+			st.prefetched ? st.lead_ms / st.prefetched : 0);
+	printf("latency pressure %ld ms, lux %ld ms; %lu sensor reads, "
+			"%lu missed\n", sampler_latency_ms(SAMPLE_BIT(SAMPLE_PRESSURE)),
+			sampler_latency_ms(SAMPLE_BIT(SAMPLE_LUX)), reads(),
+			st.missed);
+
+	/* Both go quiet: a few more refreshes, then none */
+	predict_get_stats(&st);
+	missed = st.missed;
+	t = reads();
+	sleep_until(now_ms() + (PREDICT_MAX_MISSED + 2) * 900);
+	predict_get_stats(&st);
+	printf("after the sensors stopped: %lu reads, %lu missed\n",
+			reads() - (unsigned long)t, st.missed - missed);
+	evloop_stop();
+
+	/*
+	 * All but the arrivals the periods are learned from: the first
+	 * has nothing to go on and the next sets the period.
+	 */
+	return st.prefetched + (PREDICT_CONFIDENCE + 2) * NSENSORS >=
+		st.arrivals ? 0 : 1;
+}
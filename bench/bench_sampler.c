@@ -0,0 +1,266 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Local sensor sampling against the simulated I2C bus: how long a
+ * refresh of a BMP280 and a TSL2561 takes to reach the cache as bus
+ * latency grows, whether the values that come back match what the models were
+ * given, whether sampling both at once takes the slower one's time
+ * rather than the sum, and how the sampler copes with transfers
+ * failing.  Readings come back through the event loop as they do in
+ * rtl2udp.  Runs without hardware.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "../sampler.h"
+#include "../i2csim.h"
+#include "../evloop.h"
+#include "../tsl2561.h"
+
+int debug = 0;
+
+#define READS		200
+#define PRESSURE_HPA	1006.5327	/* datasheet example raw values */
+
+static const struct {
+	unsigned int latency_us;
+	unsigned int byte_us;
+} buses[] = {
+	{ 0, 0 },
+	{ 0, 90 },	/* 100 kHz */
+	{ 100, 23 },	/* 400 kHz plus some driver overhead */
+	{ 500, 90 },
+	{ 2000, 90 },
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static unsigned long refreshes(enum sample_kind kind)
+{
+	struct sampler_stats st;
+
+	sampler_get_stats(kind, &st);
+	return st.refreshes;
+}
+
+/*
+ * Start a refresh of kind and wait for it to reach the cache.
+ * sampler_get() never waits, so this is what a miss costs before the
+ * next message sees a fresh reading.
+ */
+static void refresh(enum sample_kind kind)
+{
+	unsigned long n = refreshes(kind);
+	struct timespec tick = { 0, 50000 };
+
+	sampler_refresh(SAMPLE_BIT(kind), -1);
+	while (refreshes(kind) == n)
+		nanosleep(&tick, NULL);
+}
+
+/* Refresh kind n times; returns the number of wrong values */
+static int time_reads(enum sample_kind kind, int n, double want,
+		double tolerance, double *ms)
+{
+	double t0, value;
+	int i, wrong = 0;
+
+	for (i = 0; i < n; i++) {
+		t0 = now();
+		refresh(kind);
+		ms[i] = (now() - t0) * 1e3;
+		if (sampler_get(kind, INT_MAX, &value, NULL) < 0 ||
+				fabs(value - want) > tolerance)
+			wrong++;
+	}
+	qsort(ms, n, sizeof(double), cmp_double);
+
+	return wrong;
+}
+
+static void *loop_thread(void *arg)
+{
+	evloop_run();
+	return NULL;
+}
+
+/* Kick both sensors and wait for both readings */
+static double time_both(void)
+{
+	unsigned long p = refreshes(SAMPLE_PRESSURE), l = refreshes(SAMPLE_LUX);
+	struct timespec tick = { 0, 50000 };
+	double t0 = now();
+
+	sampler_kick();
+	while (refreshes(SAMPLE_PRESSURE) == p || refreshes(SAMPLE_LUX) == l)
+		nanosleep(&tick, NULL);
+
+	return (now() - t0) * 1e3;
+}
+
+static void set_bus(struct i2c_sim *sim, struct i2c_bus *bus,
+		unsigned int latency, unsigned int byte, unsigned int errors)
+{
+	pthread_mutex_lock(&bus->lock);
+	sim->latency_us = latency;
+	sim->byte_us = byte;
+	sim->error_rate = errors;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+static void set_light(struct i2c_sim *sim, struct i2c_bus *bus,
+		unsigned long ch0, unsigned long ch1)
+{
+	pthread_mutex_lock(&bus->lock);
+	sim->ch0 = ch0;
+	sim->ch1 = ch1;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+int main(int argc, char **argv)
+{
+	struct i2c_sim *sim;
+	struct i2c_bus *bus;
+	struct sampler_stats before, after;
+	pthread_t loop;
+	double ms[READS], lux, t0, seq, both;
+	unsigned long transfers;
+	size_t i;
+	int wrong, failed = 0;
+
+	sim = i2c_sim_attach("bus=1");
+	bus = i2c_bus_get(1);
+	if (sim == NULL || evloop_init() < 0 || sampler_add("bmp280:1") < 0 ||
+			sampler_add("tsl2561:1") < 0 || sampler_start(1) < 0 ||
+			pthread_create(&loop, NULL, loop_thread, NULL) != 0)
+		return 1;
+
+	printf("pressure refresh, ms       p50     p99     max  transfers  wrong\n");
+	for (i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+		set_bus(sim, bus, buses[i].latency_us, buses[i].byte_us, 0);
+		transfers = sim->transfers;
+		wrong = time_reads(SAMPLE_PRESSURE, READS, PRESSURE_HPA, 0.01, ms);
+		printf("latency %4u us byte %2u  %7.2f %7.2f %7.2f  %9.1f  %5d\n",
+				buses[i].latency_us, buses[i].byte_us,
+				ms[READS / 2], ms[READS * 99 / 100], ms[READS - 1],
+				(double)(sim->transfers - transfers) / READS, wrong);
+		failed += wrong;
+	}
+
+	/* The lux settings follow the light, so each is timed after settling */
+	printf("\nlux refresh, ms            p50     p99     max  lux\n");
+	set_bus(sim, bus, 100, 23, 0);
+	{
+		static const struct {
+			const char *name;
+			unsigned long ch0, ch1;
+		} light[] = {
+			{ "daylight", 2000000, 400000 },
+			{ "overcast", 200000, 60000 },
+			{ "indoors", 1000, 200 },
+			{ "night", 20, 5 },
+		};
+		size_t j;
+		int n = READS / 20;
+
+		for (j = 0; j < sizeof(light) / sizeof(light[0]); j++) {
+			set_light(sim, bus, light[j].ch0, light[j].ch1);
+			/* What the chip would see at 16x, 402 ms without clipping */
+			lux = tsl2561_lux(light[j].ch0, light[j].ch1, 1,
+					TSL2561_402MS, 0) / 1000.0;
+			time_reads(SAMPLE_LUX, 3, lux, lux, ms);
+			wrong = time_reads(SAMPLE_LUX, n, lux,
+					lux * 0.02 + 0.05, ms);
+			printf("%-25s %7.2f %7.2f %7.2f  %.2f%s\n", light[j].name,
+					ms[n / 2], ms[n * 99 / 100], ms[n - 1], lux,
+					wrong ? " WRONG" : "");
+			failed += wrong;
+		}
+	}
+
+	/* Both conversions run at once, so the pair costs the slower one */
+	printf("\nboth sensors, ms      one by one   together\n");
+	{
+		static const struct {
+			const char *name;
+			unsigned long ch0, ch1;
+		} light[] = {
+			{ "daylight", 2000000, 400000 },
+			{ "overcast", 200000, 60000 },
+		};
+		size_t j;
+		int k, n = 10;
+
+		for (j = 0; j < sizeof(light) / sizeof(light[0]); j++) {
+			set_light(sim, bus, light[j].ch0, light[j].ch1);
+			time_reads(SAMPLE_LUX, 3, 0, INFINITY, ms);
+			seq = both = 0;
+			for (k = 0; k < n; k++) {
+				t0 = now();
+				refresh(SAMPLE_PRESSURE);
+				refresh(SAMPLE_LUX);
+				seq += (now() - t0) * 1e3;
+				both += time_both();
+			}
+			printf("%-20s %11.2f %10.2f\n", light[j].name, seq / n,
+					both / n);
+		}
+	}
+
+	/* A noisy bus: reads fail, the stale value is handed out meanwhile */
+	printf("\n1 in 20 transfers failing\n");
+	set_bus(sim, bus, 100, 23, 20);
+	sampler_get_stats(SAMPLE_PRESSURE, &before);
+	transfers = sim->injected;
+	time_reads(SAMPLE_PRESSURE, READS, PRESSURE_HPA, 0.01, ms);
+	sampler_get_stats(SAMPLE_PRESSURE, &after);
+	printf("%lu reads, %lu failed, %lu errors injected, p50 %.2f ms, "
+			"max %.2f ms\n", after.refreshes - before.refreshes,
+			after.failures - before.failures, sim->injected - transfers,
+			ms[READS / 2], ms[READS - 1]);
+	set_bus(sim, bus, 0, 0, 0);
+	wrong = time_reads(SAMPLE_PRESSURE, 5, PRESSURE_HPA, 0.01, ms);
+	if (wrong) {
+		printf("pressure wrong after the errors stopped\n");
+		failed += wrong;
+	}
+
+	evloop_stop();
+
+	return failed ? 1 : 0;
+}
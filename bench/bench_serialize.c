@@ -0,0 +1,203 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Compare the WeatherFlow packet serializer against building the same
+ * packet as a cJSON tree and printing it, the way the publishers used
+ * to do it, and time the rapid_wind fast path.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../cJSON.h"
+#include "../wfpacket.h"
+
+int debug = 0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *cjson_sky(const struct sky_data *sky_data, int format)
+{
+	cJSON *sky, *obs, *ob;
+	char serial_number[15];
+	char *out;
+
+	sprintf(serial_number, "ACUSKY-%d", sky_data->sensor);
+	sky = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(sky, "serial_number", serial_number);
+	cJSON_AddStringToObject(sky, "type", "obs_sky");
+	cJSON_AddStringToObject(sky, "hub_sn", "5n1");
+	obs = cJSON_AddArrayToObject(sky, "obs");
+	ob = cJSON_AddArrayToObject(obs, "");
+	cJSON_AddNumberToObject(ob, "", sky_data->time);
+	cJSON_AddNumberToObject(ob, "", sky_data->illumination);
+	cJSON_AddNumberToObject(ob, "", sky_data->uv);
+	cJSON_AddNumberToObject(ob, "", sky_data->rainfall);
+	cJSON_AddNumberToObject(ob, "", 0);
+	cJSON_AddNumberToObject(ob, "", sky_data->wind_speed);
+	cJSON_AddNumberToObject(ob, "", sky_data->gust_speed);
+	cJSON_AddNumberToObject(ob, "", sky_data->wind_direction);
+	cJSON_AddNumberToObject(ob, "", sky_data->battery);
+	cJSON_AddNumberToObject(ob, "", sky_data->interval);
+	cJSON_AddNumberToObject(ob, "", 0);
+	cJSON_AddNumberToObject(ob, "", 0);
+	cJSON_AddNumberToObject(ob, "", sky_data->precip_type);
+	cJSON_AddNumberToObject(ob, "", 4);
+	cJSON_AddNumberToObject(sky, "firmware_revision", 35);
+
+	out = format ? cJSON_Print(sky) : cJSON_PrintUnformatted(sky);
+	cJSON_Delete(sky);
+
+	return out;
+}
+
+static char *cjson_air(const struct air_data *air_data, int format)
+{
+	cJSON *air, *obs, *ob;
+	char serial_number[15];
+	char *out;
+
+	sprintf(serial_number, "ACUAIR-%d", air_data->sensor);
+	air = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(air, "serial_number", serial_number);
+	cJSON_AddStringToObject(air, "type", "obs_air");
+	cJSON_AddStringToObject(air, "hub_sn", "5n1");
+	obs = cJSON_AddArrayToObject(air, "obs");
+	ob = cJSON_AddArrayToObject(obs, "");
+	cJSON_AddNumberToObject(ob, "", air_data->time);
+	cJSON_AddNumberToObject(ob, "", air_data->pressure);
+	cJSON_AddNumberToObject(ob, "", air_data->temperature);
+	cJSON_AddNumberToObject(ob, "", air_data->humidity);
+	cJSON_AddNumberToObject(ob, "", 0);
+	cJSON_AddNumberToObject(ob, "", 0);
+	cJSON_AddNumberToObject(ob, "", air_data->battery);
+	cJSON_AddNumberToObject(ob, "", air_data->interval);
+	cJSON_AddNumberToObject(air, "firmware_revision", 35);
+
+	out = format ? cJSON_Print(air) : cJSON_PrintUnformatted(air);
+	cJSON_Delete(air);
+
+	return out;
+}
+
+static char *cjson_rapid_wind(const struct sky_data *sky_data)
+{
+	cJSON *wind, *ob;
+	char serial_number[15];
+	char *out;
+
+	sprintf(serial_number, "ACUSKY-%d", sky_data->sensor);
+	wind = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(wind, "serial_number", serial_number);
+	cJSON_AddStringToObject(wind, "type", "rapid_wind");
+	cJSON_AddStringToObject(wind, "hub_sn", "5n1");
+	ob = cJSON_AddArrayToObject(wind, "ob");
+	cJSON_AddNumberToObject(ob, "", sky_data->time);
+	cJSON_AddNumberToObject(ob, "", sky_data->wind_speed);
+	cJSON_AddNumberToObject(ob, "", sky_data->wind_direction);
+
+	out = cJSON_PrintUnformatted(wind);
+	cJSON_Delete(wind);
+
+	return out;
+}
+
+int main(int argc, char **argv)
+{
+	struct air_data air = { 12.5, 53, 1013.27, 3.0, 1234, 1539000000, 36 };
+	struct sky_data sky = { 1.1, 1.8, 292.5, 0.3, 10234, 2.5, 3.0, 1234,
+		1539000000, 18, 1, 0.01 };
+	struct wf_packet pkt;
+	int i, n = (argc > 1) ? atoi(argv[1]) : 200000;
+	double t0, t_cjson, t_wf, t_rapid;
+	char *ref;
+	size_t total = 0, rapid = 0;
+
+	/* Both paths have to produce the same bytes */
+	ref = cjson_air(&air, 0);
+	wf_obs_air(&pkt, &air);
+	if (strcmp(ref, pkt.buf) != 0) {
+		printf("obs_air mismatch:\n  %s\n  %s\n", ref, pkt.buf);
+		return 1;
+	}
+	free(ref);
+
+	ref = cjson_sky(&sky, 0);
+	wf_obs_sky(&pkt, &sky);
+	if (strcmp(ref, pkt.buf) != 0) {
+		printf("obs_sky mismatch:\n  %s\n  %s\n", ref, pkt.buf);
+		return 1;
+	}
+	free(ref);
+
+	ref = cjson_rapid_wind(&sky);
+	wf_rapid_wind(&pkt, sky.sensor, sky.time, sky.wind_speed,
+			sky.wind_direction);
+	if (strcmp(ref, pkt.buf) != 0) {
+		printf("rapid_wind mismatch:\n  %s\n  %s\n", ref, pkt.buf);
+		return 1;
+	}
+	free(ref);
+
+	t0 = now();
+	for (i = 0; i < n; i++) {
+		air.time = sky.time = 1539000000 + i;
+		ref = cjson_air(&air, 1);
+		total += strlen(ref);
+		free(ref);
+		ref = cjson_sky(&sky, 1);
+		total += strlen(ref);
+		free(ref);
+	}
+	t_cjson = now() - t0;
+
+	t0 = now();
+	for (i = 0; i < n; i++) {
+		air.time = sky.time = 1539000000 + i;
+		total += wf_obs_air(&pkt, &air);
+		total += wf_obs_sky(&pkt, &sky);
+	}
+	t_wf = now() - t0;
+
+	t0 = now();
+	for (i = 0; i < n; i++)
+		rapid += wf_rapid_wind(&pkt, sky.sensor, 1539000000 + i,
+				sky.wind_speed, sky.wind_direction);
+	t_rapid = now() - t0;
+
+	printf("%d air+sky packet pairs (%zu bytes)\n", n, total);
+	printf("cJSON tree + print: %8.1f ns/packet\n", t_cjson * 1e9 / (2 * n));
+	printf("wfpacket:           %8.1f ns/packet\n", t_wf * 1e9 / (2 * n));
+	printf("speedup:            %8.1fx\n", t_cjson / t_wf);
+	printf("rapid_wind:         %8.1f ns/packet (%zu bytes)\n",
+			t_rapid * 1e9 / n, rapid);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Rohm BH1750 ambient light sensor.
+ *
+ * The chip has no registers, just one byte commands.  Each reading is a
+ * one time high resolution mode 2 measurement (0.5 lx steps), after
+ * which the chip powers itself down.
+ */
+#include <stdio.h>
+#include "driver.h"
+#include "rtl2udp.h"
+
+#define BH1750_ADDR	0x23	/* 0x5C with ADDR high */
+
+#define CMD_POWER_ON	0x01
+#define CMD_ONCE_HRES2	0x21
+
+#define CONVERSION_US	180000	/* datasheet maximum for H-resolution */
+
+/* The chip can't be identified; all we can do is see it acknowledge */
+static int bh_probe(struct device *dev)
+{
+	uint8_t cmd = CMD_POWER_ON;
+
+	if (i2c_write(dev->bus, dev->addr, &cmd, 1) < 0) {
+		fprintf(stderr, "No bh1750 at 0x%02x.\n", dev->addr);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int bh_init(struct device *dev)
+{
+	return 0;
+}
+
+static unsigned int bh_conversion_us(const struct device *dev)
+{
+	return CONVERSION_US;
+}
+
+static int bh_start(struct device *dev)
+{
+	uint8_t cmd = CMD_ONCE_HRES2;
+
+	return i2c_write(dev->bus, dev->addr, &cmd, 1);
+}
+
+static int bh_read(struct device *dev, struct reading *r)
+{
+	uint8_t data[2];
+	unsigned int count;
+
+	if (i2c_read(dev->bus, dev->addr, data, 2) < 0)
+		return -1;
+
+	/* Big endian count, 1.2 counts per lux, halved in mode 2 */
+	count = data[0] << 8 | data[1];
+	r->value[SAMPLE_LUX] = count / 2.4;
+	r->present |= SAMPLE_BIT(SAMPLE_LUX);
+
+	if (debug)
+		printf("BH1750: %u counts, %.1f lux\n", count,
+				r->value[SAMPLE_LUX]);
+
+	return 0;
+}
+
+const struct driver bh1750_driver = {
+	.name = "bh1750",
+	.addr = BH1750_ADDR,
+	.provides = SAMPLE_BIT(SAMPLE_LUX),
+	.priv_size = 0,
+	.probe = bh_probe,
+	.init = bh_init,
+	.start = bh_start,
+	.conversion_us = bh_conversion_us,
+	.read = bh_read,
+	.min_period_us = bh_conversion_us,
+};
@@ -0,0 +1,467 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * BMP280 and BME280 driver.  The BME280 is a BMP280 with a humidity
+ * channel added, so one driver does both.
+ *
+ * The sensor is left asleep and each reading is a forced conversion:
+ * start() writes ctrl_meas with mode 01, the caller waits the
+ * datasheet's maximum conversion time for the configured oversampling,
+ * then read() polls the status register until the measuring bit clears
+ * and burst reads the results.  At the default x1 that is under 7 ms
+ * for a BMP280, where normal mode with a 1000 ms standby used to cost
+ * a full second per sample.
+ *
+ * Compensation is the datasheet's 32/64 bit integer code by default,
+ * which is a lot cheaper than the floating point version on boards
+ * without an FPU; the double version can still be selected.
+ *
+ * The calibration words are read when the device is set up; the config
+ * register (IIR filter) is written with the first conversion, and both
+ * again after any error in case the sensor was reset.
+ */
+#include <stdio.h>
+#include "bmp280.h"
+#include "driver.h"
+#include "rtl2udp.h"
+
+#define REG_CALIB	0x88
+#define REG_CALIB_H1	0xA1
+#define REG_ID		0xD0
+#define REG_CALIB_H2	0xE1
+#define REG_CTRL_HUM	0xF2
+#define REG_STATUS	0xF3
+#define REG_CTRL_MEAS	0xF4
+#define REG_CONFIG	0xF5
+#define REG_DATA	0xF7
+
+#define BMP280_ID	0x58
+#define BME280_ID	0x60
+
+#define STATUS_MEASURING	0x08
+#define MODE_FORCED		0x01
+
+#define POLL_US		500
+#define POLL_SLACK_US	20000	/* give up this long after the max time */
+
+/* osrs_t/osrs_p code for an oversampling multiplier: x1 is 1, x16 is 5 */
+static unsigned int os_code(unsigned int os)
+{
+	unsigned int code = 1;
+
+	while (os > 1 && code < 5) {
+		os >>= 1;
+		code++;
+	}
+
+	return code;
+}
+
+/* filter code for an IIR coefficient: off is 0, 2 is 1, 16 is 4 */
+static unsigned int filter_code(unsigned int coef)
+{
+	unsigned int code = 0;
+
+	while (coef > 1 && code < 4) {
+		coef >>= 1;
+		code++;
+	}
+
+	return code;
+}
+
+static struct bmp280_config defaults = BMP280_CONFIG_DEFAULT;
+
+/*
+ * Oversampling, filter and math for devices set up from now on.
+ */
+void bmp280_set_config(const struct bmp280_config *cfg)
+{
+	defaults = *cfg;
+}
+
+static int read_calibration(struct device *dev)
+{
+	struct bmp280 *bmp = dev->priv;
+	struct bmp280_calibration *cal = &bmp->cal;
+	uint8_t data[24];
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_CALIB, data, 24) < 0) {
+		fprintf(stderr, "Failed to read coefficent data.\n");
+		return -1;
+	}
+
+	/* Little endian words, T1 and P1 unsigned, the rest signed */
+	cal->T1 = (uint16_t)(data[1] << 8 | data[0]);
+	cal->T2 = (int16_t)(data[3] << 8 | data[2]);
+	cal->T3 = (int16_t)(data[5] << 8 | data[4]);
+	cal->P1 = (uint16_t)(data[7] << 8 | data[6]);
+	cal->P2 = (int16_t)(data[9] << 8 | data[8]);
+	cal->P3 = (int16_t)(data[11] << 8 | data[10]);
+	cal->P4 = (int16_t)(data[13] << 8 | data[12]);
+	cal->P5 = (int16_t)(data[15] << 8 | data[14]);
+	cal->P6 = (int16_t)(data[17] << 8 | data[16]);
+	cal->P7 = (int16_t)(data[19] << 8 | data[18]);
+	cal->P8 = (int16_t)(data[21] << 8 | data[20]);
+	cal->P9 = (int16_t)(data[23] << 8 | data[22]);
+
+	if (!bmp->humidity)
+		return 0;
+
+	/* H1 sits after the pressure words, the rest in a block of their own */
+	if (i2c_read_reg(dev->bus, dev->addr, REG_CALIB_H1, &cal->H1, 1) < 0 ||
+			i2c_read_reg(dev->bus, dev->addr, REG_CALIB_H2, data, 7) < 0) {
+		fprintf(stderr, "Failed to read humidity coefficent data.\n");
+		return -1;
+	}
+
+	/* H4 and H5 are 12 bits sharing the nibbles of 0xE5 */
+	cal->H2 = (int16_t)(data[1] << 8 | data[0]);
+	cal->H3 = data[2];
+	cal->H4 = (int16_t)((int8_t)data[3] * 16 | (data[4] & 0x0F));
+	cal->H5 = (int16_t)((int8_t)data[5] * 16 | (data[4] >> 4));
+	cal->H6 = (int8_t)data[6];
+
+	return 0;
+}
+
+/*
+ * The integer compensation is the datasheet's (section 8.2), with its
+ * left shifts of signed values written as multiplies.  The right
+ * shifts assume an arithmetic shift as gcc does.
+ */
+int32_t bmp280_temp_int(const struct bmp280_calibration *cal, int32_t adc_t,
+		int32_t *t_fine)
+{
+	int32_t var1, var2;
+
+	var1 = (((adc_t >> 3) - ((int32_t)cal->T1 * 2)) *
+			(int32_t)cal->T2) >> 11;
+	var2 = (((((adc_t >> 4) - (int32_t)cal->T1) *
+			((adc_t >> 4) - (int32_t)cal->T1)) >> 12) *
+			(int32_t)cal->T3) >> 14;
+	*t_fine = var1 + var2;
+
+	return (*t_fine * 5 + 128) >> 8;
+}
+
+uint32_t bmp280_pressure_int(const struct bmp280_calibration *cal,
+		int32_t adc_p, int32_t t_fine)
+{
+	int64_t var1, var2, p;
+
+	var1 = (int64_t)t_fine - 128000;
+	var2 = var1 * var1 * cal->P6;
+	var2 = var2 + var1 * cal->P5 * ((int64_t)1 << 17);
+	var2 = var2 + (int64_t)cal->P4 * ((int64_t)1 << 35);
+	var1 = ((var1 * var1 * cal->P3) >> 8) +
+		var1 * cal->P2 * ((int64_t)1 << 12);
+	var1 = ((((int64_t)1 << 47) + var1) * cal->P1) >> 33;
+	if (var1 == 0)
+		return 0;	/* avoid dividing by zero */
+
+	p = 1048576 - adc_p;
+	p = ((p * ((int64_t)1 << 31)) - var2) * 3125 / var1;
+	var1 = ((int64_t)cal->P9 * (p >> 13) * (p >> 13)) >> 25;
+	var2 = ((int64_t)cal->P8 * p) >> 19;
+
+	return (uint32_t)(((p + var1 + var2) >> 8) + ((int64_t)cal->P7 * 16));
+}
+
+double bmp280_temp_double(const struct bmp280_calibration *cal, int32_t adc_t,
+		double *t_fine)
+{
+	double var1, var2;
+
+	var1 = (((double)adc_t / 16384) - ((double)cal->T1 / 1024)) * cal->T2;
+	var2 = (((double)adc_t / 131072) - ((double)cal->T1 / 8192)) *
+		(((double)adc_t / 131072) - ((double)cal->T1 / 8192)) * cal->T3;
+	*t_fine = var1 + var2;
+
+	return *t_fine / 5120;
+}
+
+double bmp280_pressure_double(const struct bmp280_calibration *cal,
+		int32_t adc_p, double t_fine)
+{
+	double var1, var2, p;
+
+	var1 = (t_fine / 2) - 64000;
+	var2 = var1 * var1 * ((double)cal->P6 / 32768);
+	var2 = var2 + var1 * ((double)cal->P5 * 2);
+	var2 = (var2 / 4) + ((double)cal->P4 * 65536);
+	var1 = ((double)cal->P3 * var1 * var1 / 524288 +
+			(double)cal->P2 * var1) / 524288;
+	var1 = (1 + var1 / 32768) * cal->P1;
+	if (var1 == 0)
+		return 0;
+
+	p = 1048576 - (double)adc_p;
+	p = (p - (var2 / 4096)) * 6250 / var1;
+
+	var1 = (double)cal->P9 * p * p / 2147483648;
+	var2 = p * (double)cal->P8 / 32768;
+
+	return p + (var1 + var2 + cal->P7) / 16;
+}
+
+uint32_t bme280_humidity_int(const struct bmp280_calibration *cal,
+		int32_t adc_h, int32_t t_fine)
+{
+	int32_t v, x, y;
+
+	v = t_fine - 76800;
+	x = ((adc_h * 16384) - ((int32_t)cal->H4 * 1048576) -
+			((int32_t)cal->H5 * v) + 16384) >> 15;
+	y = (((((((v * (int32_t)cal->H6) >> 10) *
+			(((v * (int32_t)cal->H3) >> 11) + 32768)) >> 10) +
+			2097152) * (int32_t)cal->H2) + 8192) >> 14;
+	v = x * y;
+	v = v - (((((v >> 15) * (v >> 15)) >> 7) * (int32_t)cal->H1) >> 4);
+	if (v < 0)
+		v = 0;
+	if (v > 419430400)
+		v = 419430400;
+
+	return (uint32_t)(v >> 12);
+}
+
+double bme280_humidity_double(const struct bmp280_calibration *cal,
+		int32_t adc_h, double t_fine)
+{
+	double h;
+
+	h = t_fine - 76800;
+	h = (adc_h - ((double)cal->H4 * 64 + (double)cal->H5 / 16384 * h)) *
+		((double)cal->H2 / 65536 * (1 + (double)cal->H6 / 67108864 * h *
+			(1 + (double)cal->H3 / 67108864 * h)));
+	h = h * (1 - (double)cal->H1 * h / 524288);
+	if (h > 100)
+		h = 100;
+	else if (h < 0)
+		h = 0;
+
+	return h;
+}
+
+
+static int bmp_probe(struct device *dev)
+{
+	struct bmp280 *bmp = dev->priv;
+	uint8_t id;
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_ID, &id, 1) < 0)
+		return -1;
+
+	/* Early BMP280 samples read 0x56 or 0x57 */
+	if (id != (bmp->humidity ? BME280_ID : BMP280_ID) &&
+			(bmp->humidity || id < 0x56 || id > 0x58)) {
+		fprintf(stderr, "No %s at 0x%02x (chip id 0x%02x).\n",
+				dev->drv->name, dev->addr, id);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int probe_bmp280(struct device *dev)
+{
+	((struct bmp280 *)dev->priv)->humidity = 0;
+	return bmp_probe(dev);
+}
+
+static int probe_bme280(struct device *dev)
+{
+	((struct bmp280 *)dev->priv)->humidity = 1;
+	return bmp_probe(dev);
+}
+
+static int bmp_init(struct device *dev)
+{
+	struct bmp280 *bmp = dev->priv;
+	struct bmp280_config *cfg = &bmp->cfg;
+
+	*cfg = defaults;
+
+	/* Pressure compensation needs the temperature, so neither is off */
+	if (cfg->osrs_t == 0)
+		cfg->osrs_t = 1;
+	if (cfg->osrs_p == 0)
+		cfg->osrs_p = 1;
+	if (cfg->osrs_h == 0)
+		cfg->osrs_h = 1;
+
+	/* Round down to what the sensor supports */
+	cfg->osrs_t = 1u << (os_code(cfg->osrs_t) - 1);
+	cfg->osrs_p = 1u << (os_code(cfg->osrs_p) - 1);
+	cfg->osrs_h = 1u << (os_code(cfg->osrs_h) - 1);
+	if (filter_code(cfg->filter))
+		cfg->filter = 1u << filter_code(cfg->filter);
+	else
+		cfg->filter = 0;
+
+	bmp->configured = 0;
+
+	return read_calibration(dev);
+}
+
+/*
+ * Maximum measurement time from the datasheet (section 3.8.1):
+ * 1.25 + 2.3 * T_os + (2.3 * P_os + 0.575) ms, plus (2.3 * H_os + 0.575)
+ * for a BME280.
+ */
+static unsigned int bmp_conversion_us(const struct device *dev)
+{
+	const struct bmp280 *bmp = dev->priv;
+	const struct bmp280_config *cfg = &bmp->cfg;
+	unsigned int us;
+
+	us = 1250 + 2300 * cfg->osrs_t + 2300 * cfg->osrs_p + 575;
+	if (bmp->humidity)
+		us += 2300 * cfg->osrs_h + 575;
+
+	return us;
+}
+
+static unsigned int bmp_min_period_us(const struct device *dev)
+{
+	return bmp_conversion_us(dev);
+}
+
+static int bmp_start(struct device *dev)
+{
+	struct bmp280 *bmp = dev->priv;
+	const struct bmp280_config *cfg = &bmp->cfg;
+
+	if (!bmp->configured) {
+		/* Config register: standby unused in forced mode, IIR filter */
+		if (i2c_write_reg(dev->bus, dev->addr, REG_CONFIG,
+					filter_code(cfg->filter) << 2) < 0)
+			return -1;
+		/* ctrl_hum only takes effect with the next ctrl_meas write */
+		if (bmp->humidity && i2c_write_reg(dev->bus, dev->addr,
+					REG_CTRL_HUM, os_code(cfg->osrs_h)) < 0)
+			return -1;
+		bmp->configured = 1;
+	}
+
+	return i2c_write_reg(dev->bus, dev->addr, REG_CTRL_MEAS,
+			(os_code(cfg->osrs_t) << 5) |
+			(os_code(cfg->osrs_p) << 2) | MODE_FORCED);
+}
+
+/*
+ * Wait out the end of the conversion and read the results: pressure
+ * in hPa (station pressure, not sea level), the sensor's temperature
+ * and, from a BME280, humidity.
+ */
+static int bmp_read(struct device *dev, struct reading *r)
+{
+	struct bmp280 *bmp = dev->priv;
+	const struct bmp280_calibration *cal = &bmp->cal;
+	unsigned int waited = 0;
+	uint8_t status, data[8];
+	int32_t adc_t, adc_p, adc_h, t_fine;
+	double t_fine_d, temp, pa, rh = 0;
+
+	for (;;) {
+		if (i2c_read_reg(dev->bus, dev->addr, REG_STATUS, &status, 1) < 0)
+			return -1;
+		if (!(status & STATUS_MEASURING))
+			break;
+		if (waited > POLL_SLACK_US) {
+			fprintf(stderr, "%s conversion timed out.\n", dev->drv->name);
+			return -1;
+		}
+		driver_sleep(POLL_US);
+		waited += POLL_US;
+	}
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_DATA, data,
+				bmp->humidity ? 8 : 6) < 0)
+		return -1;
+
+	/* 20 bit pressure and temperature, 16 bit humidity */
+	adc_p = (int32_t)data[0] << 12 | (int32_t)data[1] << 4 | data[2] >> 4;
+	adc_t = (int32_t)data[3] << 12 | (int32_t)data[4] << 4 | data[5] >> 4;
+	adc_h = (int32_t)data[6] << 8 | data[7];
+
+	if (bmp->cfg.math == BMP280_MATH_DOUBLE) {
+		temp = bmp280_temp_double(cal, adc_t, &t_fine_d);
+		pa = bmp280_pressure_double(cal, adc_p, t_fine_d);
+		if (bmp->humidity)
+			rh = bme280_humidity_double(cal, adc_h, t_fine_d);
+	} else {
+		temp = bmp280_temp_int(cal, adc_t, &t_fine) / 100.0;
+		pa = bmp280_pressure_int(cal, adc_p, t_fine) / 256.0;
+		if (bmp->humidity)
+			rh = bme280_humidity_int(cal, adc_h, t_fine) / 1024.0;
+	}
+
+	if (pa == 0) {
+		fprintf(stderr, "Invalid %s calibration.\n", dev->drv->name);
+		return -1;
+	}
+
+	if (debug) {
+		printf("Indoor temp = %.1f F\n", temp * 1.8 + 32);
+		printf("Pressure = %.1f hPa\n", pa / 100);
+		if (bmp->humidity)
+			printf("Humidity = %.1f %%\n", rh);
+	}
+
+	r->value[SAMPLE_PRESSURE] = pa / 100;
+	r->value[SAMPLE_TEMP] = temp;
+	r->present |= SAMPLE_BIT(SAMPLE_PRESSURE) | SAMPLE_BIT(SAMPLE_TEMP);
+	if (bmp->humidity) {
+		r->value[SAMPLE_HUMIDITY] = rh;
+		r->present |= SAMPLE_BIT(SAMPLE_HUMIDITY);
+	}
+
+	return 0;
+}
+
+const struct driver bmp280_driver = {
+	.name = "bmp280",
+	.addr = BMP280_ADDR,
+	.provides = SAMPLE_BIT(SAMPLE_PRESSURE) | SAMPLE_BIT(SAMPLE_TEMP),
+	.priv_size = sizeof(struct bmp280),
+	.probe = probe_bmp280,
+	.init = bmp_init,
+	.start = bmp_start,
+	.conversion_us = bmp_conversion_us,
+	.read = bmp_read,
+	.min_period_us = bmp_min_period_us,
+};
+
+const struct driver bme280_driver = {
+	.name = "bme280",
+	.addr = BMP280_ADDR,
+	.provides = SAMPLE_BIT(SAMPLE_PRESSURE) | SAMPLE_BIT(SAMPLE_TEMP) |
+		SAMPLE_BIT(SAMPLE_HUMIDITY),
+	.priv_size = sizeof(struct bmp280),
+	.probe = probe_bme280,
+	.init = bmp_init,
+	.start = bmp_start,
+	.conversion_us = bmp_conversion_us,
+	.read = bmp_read,
+	.min_period_us = bmp_min_period_us,
+};
@@ -0,0 +1,105 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Bosch BMP280 pressure/temperature and BME280 pressure/temperature/
+ * humidity sensors, used in forced mode.
+ */
+#ifndef BMP280_H
+#define BMP280_H
+
+#include <stdint.h>
+
+#define BMP280_ADDR	0x77
+
+/* Which of the datasheet's compensation formulas to use */
+enum bmp280_math {
+	BMP280_MATH_INT,	/* 32 bit temperature, 64 bit pressure */
+	BMP280_MATH_DOUBLE,	/* floating point */
+};
+
+/*
+ * Oversampling is given as the multiplier (1, 2, 4, 8 or 16) and the
+ * IIR filter as its coefficient (0 for off, 2, 4, 8 or 16).
+ */
+struct bmp280_config {
+	unsigned int osrs_t;
+	unsigned int osrs_p;
+	unsigned int osrs_h;	/* BME280 only */
+	unsigned int filter;
+	enum bmp280_math math;
+};
+
+#define BMP280_CONFIG_DEFAULT	{ .osrs_t = 1, .osrs_p = 1, .osrs_h = 1, \
+				  .filter = 0, .math = BMP280_MATH_INT }
+
+/* Trimming parameters as stored in the sensor's NVM */
+struct bmp280_calibration {
+	uint16_t T1;
+	int16_t T2;
+	int16_t T3;
+	uint16_t P1;
+	int16_t P2;
+	int16_t P3;
+	int16_t P4;
+	int16_t P5;
+	int16_t P6;
+	int16_t P7;
+	int16_t P8;
+	int16_t P9;
+	/* BME280 humidity */
+	uint8_t H1;
+	int16_t H2;
+	uint8_t H3;
+	int16_t H4;
+	int16_t H5;
+	int8_t H6;
+};
+
+struct bmp280 {
+	struct bmp280_config cfg;
+	int humidity;		/* a BME280 */
+	int configured;		/* config registers written */
+	struct bmp280_calibration cal;
+};
+
+void bmp280_set_config(const struct bmp280_config *cfg);
+
+/*
+ * Compensation of raw 20 bit ADC values.  The integer versions return
+ * hundredths of a degree C and Pa in Q24.8; the double versions degrees
+ * C and Pa.  Pressure needs the t_fine from the temperature and is 0
+ * if the calibration is invalid.  BME280 humidity is in %RH, Q22.10
+ * for the integer version.
+ */
+int32_t bmp280_temp_int(const struct bmp280_calibration *cal, int32_t adc_t,
+		int32_t *t_fine);
+uint32_t bmp280_pressure_int(const struct bmp280_calibration *cal,
+		int32_t adc_p, int32_t t_fine);
+double bmp280_temp_double(const struct bmp280_calibration *cal, int32_t adc_t,
+		double *t_fine);
+double bmp280_pressure_double(const struct bmp280_calibration *cal,
+		int32_t adc_p, double t_fine);
+uint32_t bme280_humidity_int(const struct bmp280_calibration *cal,
+		int32_t adc_h, int32_t t_fine);
+double bme280_humidity_double(const struct bmp280_calibration *cal,
+		int32_t adc_h, double t_fine);
+
+#endif
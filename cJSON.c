@@ -263,13 +263,139 @@ typedef struct
 /* get a pointer to the buffer at the position */
 #define buffer_at_offset(buffer) ((buffer)->content + (buffer)->offset)
 
+/* Powers of ten that are exactly representable as a double */
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+    1e21, 1e22
+};
+
+/*
+ * Locale independent fast path for the common number forms, working
+ * directly on the input.  The digits are collected into a 64 bit
+ * integer; when it fits in the 53 bit mantissa and the decimal exponent
+ * is within the exactly representable powers of ten, a single IEEE
+ * multiplication or division gives the correctly rounded result
+ * (Clinger's fast path), which is exactly what strtod returns.
+ * Returns the number of bytes consumed, or 0 to defer to strtod.
+ */
+static size_t parse_number_fast(const parse_buffer * const input_buffer, double * const number)
+{
+    const unsigned char *input = buffer_at_offset(input_buffer);
+    size_t length = input_buffer->length - input_buffer->offset;
+    size_t i = 0;
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    int exponent_sign = 1;
+    int exponent_value = 0;
+    cJSON_bool negative = false;
+    double value = 0;
+
+    if ((i < length) && (input[i] == '-'))
+    {
+        negative = true;
+        i++;
+    }
+
+    if ((i >= length) || (input[i] < '0') || (input[i] > '9'))
+    {
+        return 0;
+    }
+    for (; (i < length) && (input[i] >= '0') && (input[i] <= '9'); i++)
+    {
+        if ((mantissa != 0) && (++digits > 18))
+        {
+            return 0;
+        }
+        mantissa = (mantissa * 10) + (unsigned long long)(input[i] - '0');
+    }
+
+    if ((i < length) && (input[i] == '.'))
+    {
+        i++;
+        if ((i >= length) || (input[i] < '0') || (input[i] > '9'))
+        {
+            return 0;
+        }
+        for (; (i < length) && (input[i] >= '0') && (input[i] <= '9'); i++)
+        {
+            if ((mantissa != 0) && (++digits > 18))
+            {
+                return 0;
+            }
+            mantissa = (mantissa * 10) + (unsigned long long)(input[i] - '0');
+            exponent--;
+        }
+    }
+
+    if ((i < length) && ((input[i] == 'e') || (input[i] == 'E')))
+    {
+        i++;
+        if ((i < length) && ((input[i] == '+') || (input[i] == '-')))
+        {
+            exponent_sign = (input[i] == '-') ? -1 : 1;
+            i++;
+        }
+        if ((i >= length) || (input[i] < '0') || (input[i] > '9'))
+        {
+            return 0;
+        }
+        for (; (i < length) && (input[i] >= '0') && (input[i] <= '9'); i++)
+        {
+            if (exponent_value > 10000)
+            {
+                return 0;
+            }
+            exponent_value = (exponent_value * 10) + (input[i] - '0');
+        }
+        exponent += exponent_sign * exponent_value;
+    }
+
+    /* strtod would stop at the same place only if nothing number-like follows */
+    if ((i < length) && ((input[i] == '.') || (input[i] == 'e') || (input[i] == 'E') || (input[i] == '+') || (input[i] == '-')))
+    {
+        return 0;
+    }
+
+    if (mantissa == 0)
+    {
+        value = 0;
+    }
+    else if (mantissa > (1ULL << 53))
+    {
+        return 0;
+    }
+    else if (exponent == 0)
+    {
+        value = (double)mantissa;
+    }
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    else if ((exponent > 0) && (exponent <= 22))
+    {
+        value = (double)mantissa * exact_powers_of_ten[exponent];
+    }
+    else if ((exponent < 0) && (exponent >= -22))
+    {
+        value = (double)mantissa / exact_powers_of_ten[-exponent];
+    }
+#endif
+    else
+    {
+        return 0;
+    }
+
+    *number = negative ? -value : value;
+    return i;
+}
+
 /* Parse the input text to generate a number, and populate the result into item. */
 static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_buffer)
 {
     double number = 0;
     unsigned char *after_end = NULL;
     unsigned char number_c_string[64];
-    unsigned char decimal_point = get_decimal_point();
+    unsigned char decimal_point;
     size_t i = 0;
 
     if ((input_buffer == NULL) || (input_buffer->content == NULL))
@@ -277,6 +403,15 @@ static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_bu
         return false;
     }
 
+    i = parse_number_fast(input_buffer, &number);
+    if (i > 0)
+    {
+        input_buffer->offset += i;
+        goto number_done;
+    }
+
+    decimal_point = get_decimal_point();
+
     /* copy the number into a temporary buffer and replace '.' with the decimal point
      * of the current locale (for strtod)
      * This also takes care of '\0' not necessarily being available for marking the end of the input */
@@ -318,6 +453,9 @@ loop_end:
         return false; /* parse_error */
     }
 
+    input_buffer->offset += (size_t)(after_end - number_c_string);
+
+number_done:
     item->valuedouble = number;
 
     /* use saturation in case of overflow */
@@ -336,10 +474,24 @@ loop_end:
 
     item->type = cJSON_Number;
 
-    input_buffer->offset += (size_t)(after_end - number_c_string);
     return true;
 }
 
+CJSON_PUBLIC(size_t) cJSON_ParseDoubleFast(const char *value, size_t length, double *number)
+{
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+
+    if ((value == NULL) || (number == NULL))
+    {
+        return 0;
+    }
+
+    buffer.content = (const unsigned char*)value;
+    buffer.length = length;
+
+    return parse_number_fast(&buffer, number);
+}
+
 /* don't ask me, but the original cJSON_SetNumberValue returns an integer or double */
 CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number)
 {
@@ -471,70 +623,190 @@ static void update_offset(printbuffer * const buffer)
     buffer->offset += strlen((const char*)buffer_pointer);
 }
 
+/*
+ * Print |value| (an integer of at most 17 digits) with the given number of
+ * fractional digits, e.g. 12345 with 2 gives "123.45". Returns the length.
+ */
+static int print_scaled_integer(unsigned char * const output, unsigned long long value, cJSON_bool negative, int fractional_digits)
+{
+    unsigned char digits[24];
+    int count = 0;
+    int length = 0;
+    int i = 0;
+
+    do
+    {
+        digits[count++] = (unsigned char)('0' + (value % 10));
+        value /= 10;
+    } while ((value != 0) || (count <= fractional_digits));
+
+    if (negative)
+    {
+        output[length++] = '-';
+    }
+    for (i = count - 1; i >= 0; i--)
+    {
+        if (i == (fractional_digits - 1))
+        {
+            output[length++] = '.';
+        }
+        output[length++] = digits[i];
+    }
+    output[length] = '\0';
+
+    return length;
+}
+
+/*
+ * Shortest round trip formatting without going through the C library for
+ * the common cases:
+ *  - integral values below 1e15 are printed as integers
+ *  - other values in the range where %g uses fixed notation are scaled by
+ *    increasing powers of ten until an integer n <= 2^53 is found whose
+ *    n / 10^k converts back to the same double. Both n and 10^k are exact
+ *    doubles, so that division is correctly rounded and the check is exact.
+ *    The first k that works gives the shortest fixed notation, which is also
+ *    what %1.15g prints whenever that round trips. If no k works, every form
+ *    with up to 15 significant digits has been tried and only %1.17g is left.
+ * Returns the length, 0 if the value needs the sprintf path or -1 if it
+ * needs 17 digits.
+ */
+static int print_number_fast(unsigned char * const output, const double d)
+{
+    double magnitude = fabs(d);
+    double scaled = 0;
+    long long candidate = 0;
+    int k = 0;
+    int delta = 0;
+
+    if ((d == 0) && (1 / d < 0))
+    {
+        return 0; /* negative zero */
+    }
+
+    if ((magnitude < 1e15) && (d == floor(d)))
+    {
+        return print_scaled_integer(output, (unsigned long long)magnitude, d < 0, 0);
+    }
+
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    if ((magnitude < 1e-4) || (magnitude >= 1e15))
+    {
+        return 0;
+    }
+
+    for (k = 1; k <= 22; k++)
+    {
+        scaled = magnitude * exact_powers_of_ten[k];
+        if (scaled > 9007199254740992.0)
+        {
+            break;
+        }
+        /* scaled is off by at most one from the exact product */
+        for (delta = 0; delta <= 2; delta++)
+        {
+            candidate = (long long)(scaled + 0.5) + ((delta == 2) ? -1 : delta);
+            if ((candidate > 0) && (candidate <= 9007199254740992LL) && (((double)candidate / exact_powers_of_ten[k]) == magnitude))
+            {
+                return print_scaled_integer(output, (unsigned long long)candidate, d < 0, k);
+            }
+        }
+    }
+
+    return -1;
+#else
+    return 0;
+#endif
+}
+
 /* Render the number nicely from the given item into a string. */
 static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
 {
     unsigned char *output_pointer = NULL;
     double d = item->valuedouble;
     int length = 0;
-    size_t i = 0;
     unsigned char number_buffer[26]; /* temporary buffer to print the number into */
-    unsigned char decimal_point = get_decimal_point();
-    double test;
 
     if (output_buffer == NULL)
     {
         return false;
     }
 
+    length = cJSON_PrintDouble(d, (char*)number_buffer, sizeof(number_buffer));
+
+    /* sprintf failed or buffer overrun occured */
+    if ((length <= 0) || (length > (int)(sizeof(number_buffer) - 1)))
+    {
+        return false;
+    }
+
+    /* reserve appropriate space in the output */
+    output_pointer = ensure(output_buffer, (size_t)length + sizeof(""));
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+
+    memcpy(output_pointer, number_buffer, (size_t)length + 1);
+
+    output_buffer->offset += (size_t)length;
+
+    return true;
+}
+
+CJSON_PUBLIC(int) cJSON_PrintDouble(double number, char *buffer, size_t length)
+{
+    unsigned char number_buffer[26];
+    unsigned char decimal_point = '.';
+    int number_length = 0;
+    int i = 0;
+    double test;
+
     /* This checks for NaN and Infinity */
-    if ((d * 0) != 0)
+    if ((number * 0) != 0)
     {
-        length = sprintf((char*)number_buffer, "null");
+        number_length = sprintf((char*)number_buffer, "null");
     }
     else
     {
+        number_length = print_number_fast(number_buffer, number);
+    }
+
+    if (number_length < 0)
+    {
+        decimal_point = get_decimal_point();
+        number_length = sprintf((char*)number_buffer, "%1.17g", number);
+    }
+    else if (number_length == 0)
+    {
+        decimal_point = get_decimal_point();
+
         /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
+        number_length = sprintf((char*)number_buffer, "%1.15g", number);
 
         /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || ((double)test != d))
+        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || ((double)test != number))
         {
             /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
+            number_length = sprintf((char*)number_buffer, "%1.17g", number);
         }
     }
 
     /* sprintf failed or buffer overrun occured */
-    if ((length < 0) || (length > (int)(sizeof(number_buffer) - 1)))
+    if ((number_length < 0) || ((size_t)number_length >= length))
     {
-        return false;
-    }
-
-    /* reserve appropriate space in the output */
-    output_pointer = ensure(output_buffer, (size_t)length + sizeof(""));
-    if (output_pointer == NULL)
-    {
-        return false;
+        return -1;
     }
 
     /* copy the printed number to the output and replace locale
      * dependent decimal point with '.' */
-    for (i = 0; i < ((size_t)length); i++)
+    for (i = 0; i < number_length; i++)
     {
-        if (number_buffer[i] == decimal_point)
-        {
-            output_pointer[i] = '.';
-            continue;
-        }
-
-        output_pointer[i] = number_buffer[i];
+        buffer[i] = (number_buffer[i] == decimal_point) ? '.' : (char)number_buffer[i];
     }
-    output_pointer[i] = '\0';
+    buffer[i] = '\0';
 
-    output_buffer->offset += (size_t)length;
-
-    return true;
+    return number_length;
 }
 
 /* parse 4 digit hexadecimal number */
@@ -999,6 +1271,22 @@ static parse_buffer *skip_utf8_bom(parse_buffer * const buffer)
 
 /* Parse an object - create a new root, and populate. */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    size_t buffer_length;
+
+    if (NULL == value)
+    {
+        return NULL;
+    }
+
+    /* Adding null character size due to require_null_terminated. */
+    buffer_length = strlen(value) + sizeof("");
+
+    return cJSON_ParseWithLengthOpts(value, buffer_length, return_parse_end, require_null_terminated);
+}
+
+/* Parse an object - create a new root, and populate. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
 {
     parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
     cJSON *item = NULL;
@@ -1007,13 +1295,13 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
     global_error.json = NULL;
     global_error.position = 0;
 
-    if (value == NULL)
+    if (value == NULL || 0 == buffer_length)
     {
         goto fail;
     }
 
     buffer.content = (const unsigned char*)value;
-    buffer.length = strlen((const char*)value) + sizeof("");
+    buffer.length = buffer_length;
     buffer.offset = 0;
     buffer.hooks = global_hooks;
 
@@ -1083,6 +1371,11 @@ CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
     return cJSON_ParseWithOpts(value, 0, 0);
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    return cJSON_ParseWithLengthOpts(value, buffer_length, 0, 0);
+}
+
 #define cjson_min(a, b) ((a < b) ? a : b)
 
 static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
@@ -0,0 +1,145 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Decoder registry.
+ *
+ * Model names are interned in a fixed open addressing table, kept at
+ * most half full, so finding the decoder for a message is one hash of
+ * the name, a probe or two and a memcmp() however many models are
+ * supported.  The hash is the one the sensor table keys on, so it is
+ * computed once per message.
+ *
+ * Models without a decoder are interned too, with a NULL decoder.  A
+ * neighbour's sensor that shows up every minute then costs a lookup
+ * and nothing more, and the list of models seen can be printed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decoder.h"
+#include "sensortab.h"
+#include "rtl2udp.h"
+
+#define DECODER_MAX	(DECODER_SLOTS / 2)
+
+static struct model models[DECODER_SLOTS];
+static unsigned int nmodels;
+
+/*
+ * Find the slot for a name: either the one holding it or the empty one
+ * where it belongs.
+ */
+static struct model *probe(const char *name, size_t len, uint32_t hash)
+{
+	struct model *m;
+	uint32_t i;
+
+	for (i = hash & (DECODER_SLOTS - 1); ; i = (i + 1) & (DECODER_SLOTS - 1)) {
+		m = &models[i];
+		if (m->name == NULL)
+			return m;
+		if (m->hash == hash && m->len == len &&
+				memcmp(m->name, name, len) == 0)
+			return m;
+	}
+}
+
+static struct model *intern(const char *name, size_t len, uint32_t hash,
+		struct model *m)
+{
+	char *copy;
+
+	if (nmodels >= DECODER_MAX)
+		return NULL;
+
+	copy = (char *)malloc(len + 1);
+	if (copy == NULL)
+		return NULL;
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+
+	m->name = copy;
+	m->len = len;
+	m->hash = hash;
+	m->decode = NULL;
+	m->prefix = NULL;
+	m->messages = 0;
+	nmodels++;
+
+	return m;
+}
+
+/*
+ * Register the decoders in table.  A model listed twice keeps its first
+ * decoder.
+ */
+int decoder_init(const struct decoder *table, size_t n)
+{
+	struct model *m;
+	uint32_t hash;
+	size_t i, len;
+
+	for (i = 0; i < n; i++) {
+		len = strlen(table[i].model);
+		hash = sensor_model_hash(table[i].model, len);
+		m = probe(table[i].model, len, hash);
+		if (m->name == NULL) {
+			if (intern(table[i].model, len, hash, m) == NULL) {
+				fprintf(stderr, "Too many decoders.\n");
+				return -1;
+			}
+			m->decode = table[i].decode;
+			m->prefix = table[i].prefix;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Get the interned model for a name.  Returns NULL only when the table
+ * is full and the name is new.
+ */
+struct model *decoder_lookup(const char *name, size_t len)
+{
+	struct model *m;
+	uint32_t hash;
+
+	hash = sensor_model_hash(name, len);
+	m = probe(name, len, hash);
+	if (m->name == NULL) {
+		m = intern(name, len, hash, m);
+		if (m && debug)
+			printf("No decoder for model \"%s\"\n", m->name);
+	}
+
+	return m;
+}
+
+void decoder_foreach(void (*fn)(const struct model *m))
+{
+	unsigned int i;
+
+	for (i = 0; i < DECODER_SLOTS; i++) {
+		if (models[i].name)
+			fn(&models[i]);
+	}
+}
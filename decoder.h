@@ -0,0 +1,61 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Decoder registry.  Maps rtl_433 model names to the function that
+ * turns their messages into packets.
+ */
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "extract.h"
+
+#define DECODER_SLOTS	512	/* models, known and seen; a power of 2 */
+
+struct model;
+
+typedef void (*decode_fn)(const struct rtl_msg *msg, const struct model *m);
+
+struct decoder {
+	const char *model;
+	decode_fn decode;
+	const char *prefix;	/* serial number prefix, unique per model */
+};
+
+/*
+ * An interned model name.  Every model seen gets one, whether or not
+ * there is a decoder for it.
+ */
+struct model {
+	const char *name;
+	size_t len;
+	uint32_t hash;		/* sensor_model_hash() of the name */
+	decode_fn decode;	/* NULL if the model isn't supported */
+	const char *prefix;	/* from the decoder, or NULL */
+	unsigned long messages;
+};
+
+int decoder_init(const struct decoder *table, size_t n);
+struct model *decoder_lookup(const char *name, size_t len);
+void decoder_foreach(void (*fn)(const struct model *m));
+
+#endif
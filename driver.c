@@ -0,0 +1,157 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Driver table and device setup.
+ *
+ * A device is given as name[:bus[:address]], for instance "bme280",
+ * "bh1750:0" or "bmp280:1:0x76".  The bus defaults to 1, the Pi's
+ * header bus, and the address to the driver's usual one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "driver.h"
+
+#define DEFAULT_BUS	1
+
+static const struct driver *drivers[] = {
+	&bmp280_driver,
+	&bme280_driver,
+	&tsl2561_driver,
+	&bh1750_driver,
+	&si1145_driver,
+};
+
+#define NDRIVERS	(sizeof(drivers) / sizeof(drivers[0]))
+
+static const char *sample_names[SAMPLE_MAX] = {
+	[SAMPLE_PRESSURE] = "pressure",
+	[SAMPLE_LUX] = "lux",
+	[SAMPLE_TEMP] = "temperature",
+	[SAMPLE_HUMIDITY] = "humidity",
+	[SAMPLE_UV] = "uv",
+};
+
+int device_parse(struct device *dev, const char *spec)
+{
+	const struct driver *drv = NULL;
+	const char *colon;
+	size_t len, i;
+	long bus = DEFAULT_BUS, addr = -1;
+	char *end;
+
+	colon = strchr(spec, ':');
+	len = colon ? (size_t)(colon - spec) : strlen(spec);
+	for (i = 0; i < NDRIVERS; i++) {
+		if (strlen(drivers[i]->name) == len &&
+				strncmp(drivers[i]->name, spec, len) == 0)
+			drv = drivers[i];
+	}
+	if (drv == NULL) {
+		fprintf(stderr, "Unknown sensor %.*s.\n", (int)len, spec);
+		return -1;
+	}
+
+	if (colon) {
+		bus = strtol(colon + 1, &end, 10);
+		if (end == colon + 1 || (*end != '\0' && *end != ':')) {
+			fprintf(stderr, "Bad bus in %s.\n", spec);
+			return -1;
+		}
+		if (*end == ':') {
+			colon = end;
+			addr = strtol(colon + 1, &end, 0);
+			if (end == colon + 1 || *end != '\0' ||
+					addr < 0x03 || addr > 0x77) {
+				fprintf(stderr, "Bad address in %s.\n", spec);
+				return -1;
+			}
+		}
+	}
+
+	memset(dev, 0, sizeof(*dev));
+	dev->drv = drv;
+	dev->bus_nr = bus;
+	dev->bus = i2c_bus_get(bus);
+	dev->addr = (addr < 0) ? drv->addr : (uint16_t)addr;
+	if (dev->bus == NULL) {
+		fprintf(stderr, "Bad bus in %s.\n", spec);
+		return -1;
+	}
+	if (drv->priv_size) {
+		dev->priv = calloc(1, drv->priv_size);
+		if (dev->priv == NULL)
+			return -1;
+	}
+
+	return 0;
+}
+
+void device_free(struct device *dev)
+{
+	free(dev->priv);
+	dev->priv = NULL;
+}
+
+/*
+ * Probe and initialise a device that isn't ready yet, or was reset.
+ */
+int device_prepare(struct device *dev)
+{
+	if (dev->ready)
+		return 0;
+
+	if (dev->drv->probe(dev) < 0 || dev->drv->init(dev) < 0)
+		return -1;
+
+	dev->ready = 1;
+
+	return 0;
+}
+
+/*
+ * Sleep through a conversion, or part of one.
+ */
+void driver_sleep(unsigned int us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000L;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+const char *sample_name(enum sample_kind kind)
+{
+	return sample_names[kind];
+}
+
+void driver_list(FILE *fp)
+{
+	size_t i;
+
+	for (i = 0; i < NDRIVERS; i++)
+		fprintf(fp, "%s%s", i ? " " : "", drivers[i]->name);
+	fprintf(fp, "\n");
+}
@@ -0,0 +1,96 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Local sensor drivers.  A driver knows how to find one kind of chip on
+ * an I2C bus, set it up and take a reading in two steps, starting a
+ * conversion and reading the result, so the caller decides what to do
+ * while the chip is busy.  Devices are a driver bound to a bus and an
+ * address, picked from the command line.
+ */
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "i2c.h"
+
+/* What the local sensors can measure */
+enum sample_kind {
+	SAMPLE_PRESSURE,	/* station pressure in hPa */
+	SAMPLE_LUX,		/* illuminance in lux */
+	SAMPLE_TEMP,		/* indoor temperature in C */
+	SAMPLE_HUMIDITY,	/* indoor relative humidity in % */
+	SAMPLE_UV,		/* UV index */
+	SAMPLE_MAX
+};
+
+#define SAMPLE_BIT(k)	(1u << (k))
+
+struct reading {
+	unsigned int present;	/* SAMPLE_BIT()s of the values set */
+	double value[SAMPLE_MAX];
+};
+
+struct device;
+
+/*
+ * start() begins a conversion; read() is called conversion_us() later
+ * and returns 0 with the values, 1 if it wants to be started again (with
+ * a different range, say) or -1 on error.  After an error the device is
+ * probed and initialised again before the next reading.
+ */
+struct driver {
+	const char *name;
+	uint16_t addr;			/* usual address */
+	unsigned int provides;		/* SAMPLE_BIT()s */
+	size_t priv_size;		/* driver state, zeroed */
+	int (*probe)(struct device *dev);
+	int (*init)(struct device *dev);
+	int (*start)(struct device *dev);
+	unsigned int (*conversion_us)(const struct device *dev);
+	int (*read)(struct device *dev, struct reading *r);
+	unsigned int (*min_period_us)(const struct device *dev);
+};
+
+struct device {
+	const struct driver *drv;
+	struct i2c_bus *bus;
+	int bus_nr;
+	uint16_t addr;
+	int ready;		/* probed and initialised */
+	void *priv;
+};
+
+extern const struct driver bmp280_driver;
+extern const struct driver bme280_driver;
+extern const struct driver tsl2561_driver;
+extern const struct driver bh1750_driver;
+extern const struct driver si1145_driver;
+
+int device_parse(struct device *dev, const char *spec);
+void device_free(struct device *dev);
+int device_prepare(struct device *dev);
+void driver_sleep(unsigned int us);
+const char *sample_name(enum sample_kind kind);
+void driver_list(FILE *fp);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * epoll based event loop.
+ *
+ * Every source is a file descriptor; periodic work uses a timerfd so
+ * timers and input are waited on in the same epoll_wait() call.
+ * Sources removed while events are being dispatched are freed only
+ * after the batch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/timerfd.h>
+#include "evloop.h"
+
+#define EVLOOP_MAXEVENTS	32
+
+static int epfd = -1;
+static volatile sig_atomic_t running;	/* cleared from signal handlers */
+static int dispatching;
+static struct ev_source *dead[EVLOOP_MAXEVENTS];
+static int ndead;
+
+int evloop_init(void)
+{
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		return -1;
+	}
+
+	return 0;
+}
+
+struct ev_source *evloop_add(int fd, uint32_t events, ev_handler handler,
+		void *arg)
+{
+	struct ev_source *src;
+	struct epoll_event ev;
+
+	src = (struct ev_source *)calloc(1, sizeof(struct ev_source));
+	if (src == NULL)
+		return NULL;
+
+	src->fd = fd;
+	src->handler = handler;
+	src->arg = arg;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = src;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		perror("epoll_ctl");
+		free(src);
+		return NULL;
+	}
+
+	return src;
+}
+
+/*
+ * Stop watching a source.  The file descriptor is not closed, except
+ * for timers, which own theirs.
+ */
+void evloop_del(struct ev_source *src)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, src->fd, NULL);
+	if (src->timer)
+		close(src->fd);
+
+	src->fd = -1;
+	if (dispatching && ndead < EVLOOP_MAXEVENTS)
+		dead[ndead++] = src;
+	else
+		free(src);
+}
+
+static void timer_ready(struct ev_source *src, uint32_t events)
+{
+	uint64_t expirations;
+
+	/* Runs the handler once even if several periods were missed */
+	if (read(src->fd, &expirations, sizeof(expirations)) > 0)
+		src->timer(src->arg);
+}
+
+struct ev_source *evloop_timer(unsigned int period_ms,
+		ev_timer_handler handler, void *arg)
+{
+	struct ev_source *src;
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		perror("timerfd_create");
+		return NULL;
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_interval.tv_sec = period_ms / 1000;
+	its.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+		perror("timerfd_settime");
+		close(fd);
+		return NULL;
+	}
+
+	src = evloop_add(fd, EPOLLIN, timer_ready, arg);
+	if (src == NULL) {
+		close(fd);
+		return NULL;
+	}
+	src->timer = handler;
+
+	return src;
+}
+
+int evloop_run(void)
+{
+	struct epoll_event events[EVLOOP_MAXEVENTS];
+	struct ev_source *src;
+	int i, n;
+
+	running = 1;
+	while (running) {
+		n = epoll_wait(epfd, events, EVLOOP_MAXEVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			return -1;
+		}
+
+		dispatching = 1;
+		for (i = 0; i < n; i++) {
+			src = (struct ev_source *)events[i].data.ptr;
+			if (src->fd >= 0)
+				src->handler(src, events[i].events);
+		}
+		dispatching = 0;
+
+		while (ndead > 0)
+			free(dead[--ndead]);
+	}
+
+	return 0;
+}
+
+/*
+ * Make evloop_run() return.  Safe to call from a signal handler.
+ */
+void evloop_stop(void)
+{
+	running = 0;
+}
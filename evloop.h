@@ -0,0 +1,52 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * epoll based event loop.  File descriptors and periodic timers are
+ * registered with a handler that is called when they are ready.
+ */
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+struct ev_source;
+
+typedef void (*ev_handler)(struct ev_source *src, uint32_t events);
+typedef void (*ev_timer_handler)(void *arg);
+
+struct ev_source {
+	int fd;
+	ev_handler handler;
+	ev_timer_handler timer;	/* set for timer sources */
+	void *arg;
+};
+
+int evloop_init(void);
+struct ev_source *evloop_add(int fd, uint32_t events, ev_handler handler,
+		void *arg);
+void evloop_del(struct ev_source *src);
+struct ev_source *evloop_timer(unsigned int period_ms,
+		ev_timer_handler handler, void *arg);
+int evloop_run(void);
+void evloop_stop(void);
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Single pass field extraction from rtl_433 JSON lines.
+ *
+ * rtl_433 prints one flat JSON object per line.  Instead of building a
+ * cJSON tree and then searching it for each key, extract_line() walks
+ * the line once and stores the values of the keys we know about in a
+ * struct rtl_msg.  Nothing is allocated.  Anything it does not
+ * understand (nested objects or arrays, escapes in the strings we
+ * keep, malformed input) makes it give up, and the caller falls back
+ * to cJSON and extract_from_cjson().
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "extract.h"
+
+enum value_type {
+	VAL_NUMBER,
+	VAL_STRING,
+	VAL_OTHER	/* true, false, null */
+};
+
+struct value {
+	enum value_type type;
+	double number;
+	const char *str;
+	size_t len;
+	int escaped;
+};
+
+struct field {
+	const char *key;
+	size_t key_len;
+};
+
+static const struct field fields[FIELD_COUNT] = {
+#define X(name, key)	[FIELD_##name] = { key, sizeof(key) - 1 },
+	RTL_FIELDS(X)
+#undef X
+};
+
+/* Same saturation cJSON uses for valueint */
+int msg_int(const struct rtl_msg *msg, enum rtl_field field)
+{
+	double d = msg->num[field];
+
+	if (d >= INT_MAX)
+		return INT_MAX;
+	if (d <= INT_MIN)
+		return INT_MIN;
+	return (int)d;
+}
+
+static void store(struct rtl_msg *msg, int field, const struct value *v)
+{
+	msg->present |= 1u << field;
+
+	if (v->type == VAL_NUMBER)
+		msg->num[field] = v->number;
+	if (v->type == VAL_STRING) {
+		msg->str[field].p = v->str;
+		msg->str[field].len = v->len;
+	}
+}
+
+/*
+ * Field number of a key, or -1.
+ */
+static int lookup(const char *key, size_t len)
+{
+	int i;
+
+	for (i = 0; i < FIELD_COUNT; i++) {
+		if (fields[i].key_len == len &&
+				memcmp(fields[i].key, key, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static const char *skip_ws(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+		p++;
+	return p;
+}
+
+/*
+ * Scan a string starting after the opening quote.  Returns a pointer
+ * past the closing quote or NULL.
+ */
+static const char *scan_string(const char *p, const char *end,
+		struct value *v)
+{
+	v->type = VAL_STRING;
+	v->str = p;
+	v->escaped = 0;
+
+	while (p < end && *p != '"') {
+		if (*p == '\\') {
+			v->escaped = 1;
+			p++;
+		}
+		p++;
+	}
+	if (p >= end)
+		return NULL;
+
+	v->len = (size_t)(p - v->str);
+	return p + 1;
+}
+
+static const char *scan_number(const char *p, const char *end,
+		struct value *v)
+{
+	char tmp[64];
+	const char *start = p;
+	char *after;
+	long long n = 0;
+	int neg = 0, simple = 1;
+	size_t len;
+
+	if (p < end && *p == '-') {
+		neg = 1;
+		p++;
+	}
+	while (p < end && *p >= '0' && *p <= '9') {
+		n = n * 10 + (*p - '0');
+		p++;
+	}
+	if (p == start + neg || p - start > 18)
+		simple = 0;
+	while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' ||
+				*p == 'e' || *p == 'E' || *p == '+' || *p == '-')) {
+		simple = 0;
+		p++;
+	}
+
+	v->type = VAL_NUMBER;
+	if (simple) {
+		/* Plain integer, exact in a double */
+		v->number = (double)(neg ? -n : n);
+		return p;
+	}
+
+	/* The same fast path as cJSON, then strtod for what it declines */
+	len = (size_t)(p - start);
+	if (len > 0 && cJSON_ParseDoubleFast(start, len, &v->number) == len)
+		return p;
+
+	if (len == 0 || len >= sizeof(tmp))
+		return NULL;
+	memcpy(tmp, start, len);
+	tmp[len] = '\0';
+
+	v->number = strtod(tmp, &after);
+	if (after != tmp + len)
+		return NULL;
+
+	return p;
+}
+
+static const char *scan_literal(const char *p, const char *end,
+		struct value *v)
+{
+	static const char *literals[] = { "true", "false", "null" };
+	size_t i, n;
+
+	v->type = VAL_OTHER;
+	for (i = 0; i < 3; i++) {
+		n = strlen(literals[i]);
+		if ((size_t)(end - p) >= n && memcmp(p, literals[i], n) == 0)
+			return p + n;
+	}
+
+	return NULL;
+}
+
+/*
+ * Extract the known fields from one line.  Returns 0 on success and
+ * -1 if the line has to go through cJSON instead.
+ */
+int extract_line(const char *line, size_t len, struct rtl_msg *msg)
+{
+	const char *p = line, *end = line + len;
+	const char *key;
+	size_t key_len;
+	struct value v;
+	int field;
+
+	memset(msg, 0, sizeof(struct rtl_msg));
+
+	p = skip_ws(p, end);
+	if (p >= end || *p++ != '{')
+		return -1;
+
+	p = skip_ws(p, end);
+	if (p < end && *p == '}')
+		return skip_ws(p + 1, end) == end ? 0 : -1;
+
+	for (;;) {
+		/* key */
+		if (p >= end || *p++ != '"')
+			return -1;
+		key = p;
+		p = memchr(p, '"', (size_t)(end - p));
+		if (p == NULL || memchr(key, '\\', (size_t)(p - key)))
+			return -1;
+		key_len = (size_t)(p - key);
+		p = skip_ws(p + 1, end);
+		if (p >= end || *p++ != ':')
+			return -1;
+		p = skip_ws(p, end);
+		if (p >= end)
+			return -1;
+
+		/* value */
+		if (*p == '"')
+			p = scan_string(p + 1, end, &v);
+		else if (*p == '-' || (*p >= '0' && *p <= '9'))
+			p = scan_number(p, end, &v);
+		else if (*p == 't' || *p == 'f' || *p == 'n')
+			p = scan_literal(p, end, &v);
+		else
+			return -1;	/* nested object or array */
+		if (p == NULL)
+			return -1;
+
+		/* cJSON lookups find the first of duplicate keys */
+		field = lookup(key, key_len);
+		if (field >= 0 && !(msg->present & (1u << field))) {
+			if (v.type == VAL_STRING && v.escaped)
+				return -1;
+			store(msg, field, &v);
+		}
+
+		p = skip_ws(p, end);
+		if (p >= end)
+			return -1;
+		if (*p == '}')
+			break;
+		if (*p++ != ',')
+			return -1;
+		p = skip_ws(p, end);
+	}
+
+	return skip_ws(p + 1, end) == end ? 0 : -1;
+}
+
+/*
+ * Fill a struct rtl_msg from a parsed cJSON tree.
+ */
+void extract_from_cjson(const cJSON *json, struct rtl_msg *msg)
+{
+	const cJSON *item;
+	struct value v;
+	int field;
+
+	memset(msg, 0, sizeof(struct rtl_msg));
+
+	for (item = json ? json->child : NULL; item; item = item->next) {
+		if (item->string == NULL)
+			continue;
+		field = lookup(item->string, strlen(item->string));
+		if (field < 0 || (msg->present & (1u << field)))
+			continue;
+
+		memset(&v, 0, sizeof(v));
+		if (cJSON_IsNumber(item)) {
+			v.type = VAL_NUMBER;
+			v.number = item->valuedouble;
+		} else if (cJSON_IsString(item) && item->valuestring) {
+			v.type = VAL_STRING;
+			v.str = item->valuestring;
+			v.len = strlen(item->valuestring);
+		} else {
+			v.type = VAL_OTHER;
+		}
+		store(msg, field, &v);
+	}
+}
@@ -0,0 +1,90 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Single pass field extraction from rtl_433 JSON lines.
+ */
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#include <stddef.h>
+#include "cJSON.h"
+
+/*
+ * The rtl_433 fields rtl2udp uses, as X(name, JSON key).  This list
+ * generates the field numbers, the MSG_ presence bits and the
+ * extractor's key table; adding a field is one line here.  Current
+ * rtl_433 renamed some keys, so both spellings are listed; the last
+ * three are the current names.
+ */
+#define RTL_FIELDS(X) \
+	X(MODEL,		"model") \
+	X(ID,			"id") \
+	X(SENSOR_ID,		"sensor_id") \
+	X(SEQUENCE_NUM,		"sequence_num") \
+	X(MESSAGE_TYPE,		"message_type") \
+	X(BATTERY,		"battery") \
+	X(TEMPERATURE_F,	"temperature_F") \
+	X(TEMPERATURE_C,	"temperature_C") \
+	X(HUMIDITY,		"humidity") \
+	X(WIND_SPEED_MPH,	"wind_speed_mph") \
+	X(WIND_DIR_DEG,		"wind_dir_deg") \
+	X(RAINFALL_INCH,	"rainfall_accumulation_inch") \
+	X(BATTERY_OK,		"battery_ok") \
+	X(WIND_AVG_KMH,		"wind_avg_km_h") \
+	X(RAIN_IN,		"rain_in")
+
+enum rtl_field {
+#define X(name, key)	FIELD_##name,
+	RTL_FIELDS(X)
+#undef X
+	FIELD_COUNT
+};
+
+/* Bits in rtl_msg.present */
+enum {
+#define X(name, key)	MSG_##name = 1u << FIELD_##name,
+	RTL_FIELDS(X)
+#undef X
+};
+
+struct rtl_str {
+	const char *p;		/* NULL if the value isn't a string */
+	size_t len;
+};
+
+/*
+ * The fields of an rtl_433 message, indexed by enum rtl_field.  Strings
+ * point into the input line (or the cJSON tree) and are not
+ * terminated.  Like cJSON, a value given as a string reads as 0 in
+ * num[] and one given as a number has no string.
+ */
+struct rtl_msg {
+	const char *line;	/* the whole message, set by the caller */
+	unsigned int present;
+	double num[FIELD_COUNT];
+	struct rtl_str str[FIELD_COUNT];
+};
+
+int extract_line(const char *line, size_t len, struct rtl_msg *msg);
+void extract_from_cjson(const cJSON *json, struct rtl_msg *msg);
+int msg_int(const struct rtl_msg *msg, enum rtl_field field);
+
+#endif
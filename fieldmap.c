@@ -0,0 +1,94 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Field schemas.
+ *
+ * A decoder describes which message fields land where in its sensor
+ * data with a table of FIELD_MAP() entries, and fieldmap_apply() does
+ * the presence check, conversion and store for all of them in one
+ * loop.  Fields missing from the message leave the target untouched,
+ * so a sensor keeps its last value for anything a message doesn't
+ * carry.  Entries are applied in order; when two map to the same
+ * member, the later one wins if both are present.
+ */
+#include <string.h>
+#include <math.h>
+#include "fieldmap.h"
+
+double tempc(double tempf) {
+	return round(((tempf  - 32) / 1.8) * 10) / 10;
+}
+
+double mph2ms(double mph) {
+	return round((mph * .44704) * 10) / 10;
+}
+
+double kmh2ms(double kmh) {
+	return round((kmh / 3.6) * 10) / 10;
+}
+
+double in2mm(double in) {
+	return round((in * 25.4) * 10) / 10;
+}
+
+void fieldmap_apply(const struct rtl_msg *msg, const struct field_map *map,
+		size_t n, void *dst)
+{
+	const struct rtl_str *s;
+	char *t;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!(msg->present & (1u << map[i].field)))
+			continue;
+
+		t = (char *)dst + map[i].offset;
+		switch (map[i].conv) {
+			case CONV_NONE:
+				*(double *)t = msg->num[map[i].field];
+				break;
+			case CONV_INT:
+				*(int *)t = msg_int(msg, map[i].field);
+				break;
+			case CONV_TEMPC:
+				*(double *)t = tempc(msg->num[map[i].field]);
+				break;
+			case CONV_MPH2MS:
+				*(double *)t = mph2ms(msg->num[map[i].field]);
+				break;
+			case CONV_KMH2MS:
+				*(double *)t = kmh2ms(msg->num[map[i].field]);
+				break;
+			case CONV_BATTERY:
+				s = &msg->str[map[i].field];
+				if (s->p == NULL)
+					*(double *)t = msg->num[map[i].field];
+				else if (s->len == 2 && memcmp(s->p, "OK", 2) == 0)
+					*(double *)t = 3.0;
+				else
+					*(double *)t = 2.0;
+				break;
+			case CONV_BATTERY_OK:
+				*(double *)t = msg->num[map[i].field] ? 3.0 : 2.0;
+				break;
+		}
+	}
+}
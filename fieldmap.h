@@ -0,0 +1,62 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Schema driven copying of message fields into sensor data.
+ */
+#ifndef FIELDMAP_H
+#define FIELDMAP_H
+
+#include <stddef.h>
+#include "extract.h"
+
+enum field_conv {
+	CONV_NONE,	/* double as is */
+	CONV_INT,	/* int, saturated like cJSON's valueint */
+	CONV_TEMPC,	/* Fahrenheit to Celsius */
+	CONV_MPH2MS,	/* mph to m/s */
+	CONV_KMH2MS,	/* km/h to m/s */
+	CONV_BATTERY,	/* "OK" is 3.0, any other string 2.0, numbers as is */
+	CONV_BATTERY_OK,	/* battery_ok: 1 is 3.0, 0 is 2.0, like CONV_BATTERY */
+};
+
+struct field_map {
+	unsigned char field;	/* enum rtl_field */
+	unsigned char conv;	/* enum field_conv */
+	unsigned short offset;	/* of the member in the target struct */
+};
+
+/*
+ * One schema entry: copy message field f into member of type, converted
+ * with conv.
+ */
+#define FIELD_MAP(f, type, member, conv) \
+	{ FIELD_##f, CONV_##conv, offsetof(type, member) }
+
+#define FIELD_MAP_LEN(map)	(sizeof(map) / sizeof((map)[0]))
+
+double tempc(double tempf);
+double mph2ms(double mph);
+double kmh2ms(double kmh);
+double in2mm(double in);
+void fieldmap_apply(const struct rtl_msg *msg, const struct field_map *map,
+		size_t n, void *dst);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * I2C transport.
+ *
+ * The bus device is opened on first use and stays open.  Every
+ * transfer goes through ioctl(I2C_RDWR), which carries the slave
+ * address in each message, so there is no I2C_SLAVE state to switch
+ * between devices and a register read is a write of the register
+ * number and a repeated start read in a single call, with no stop
+ * condition in between.  When a transfer fails the descriptor is
+ * closed and the next transfer opens the bus again, which covers an
+ * adapter that went away and came back.
+ *
+ * Buses are looked up by number, /dev/i2c-N, so devices on the same
+ * adapter share one descriptor and lock.
+ *
+ * Transfers go through a backend: the kernel's i2c-dev interface here,
+ * or the simulated bus in i2csim.c for running without hardware.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "i2c.h"
+
+static struct i2c_bus buses[I2C_MAX_BUS];
+static char bus_paths[I2C_MAX_BUS][16];
+
+/*
+ * The bus for /dev/i2c-nr.  Not thread safe; look buses up before
+ * starting anything that uses them.
+ */
+struct i2c_bus *i2c_bus_get(int nr)
+{
+	struct i2c_bus *bus;
+
+	if (nr < 0 || nr >= I2C_MAX_BUS)
+		return NULL;
+
+	bus = &buses[nr];
+	if (bus->path == NULL) {
+		snprintf(bus_paths[nr], sizeof(bus_paths[nr]), "/dev/i2c-%d", nr);
+		bus->path = bus_paths[nr];
+		bus->fd = -1;
+		bus->backend = &i2c_dev_backend;
+		pthread_mutex_init(&bus->lock, NULL);
+	}
+
+	return bus;
+}
+
+static int bus_fd(struct i2c_bus *bus)
+{
+	if (bus->fd >= 0)
+		return bus->fd;
+
+	bus->fd = open(bus->path, O_RDWR | O_CLOEXEC);
+	if (bus->fd < 0) {
+		if (!bus->failed)
+			fprintf(stderr, "Failed to open I2C bus %s.\n", bus->path);
+		bus->failed = 1;
+		return -1;
+	}
+
+	bus->failed = 0;
+	bus->opens++;
+
+	return bus->fd;
+}
+
+static int dev_transfer(struct i2c_bus *bus, struct i2c_msg *msgs, int n)
+{
+	struct i2c_rdwr_ioctl_data xfer;
+	int fd, ret;
+
+	xfer.msgs = msgs;
+	xfer.nmsgs = n;
+
+	fd = bus_fd(bus);
+	if (fd < 0)
+		return -1;
+
+	do {
+		ret = ioctl(fd, I2C_RDWR, &xfer);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		close(bus->fd);
+		bus->fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void dev_close(struct i2c_bus *bus)
+{
+	if (bus->fd >= 0)
+		close(bus->fd);
+	bus->fd = -1;
+}
+
+/* The kernel's /dev/i2c-N interface */
+const struct i2c_backend i2c_dev_backend = {
+	.name = "i2c-dev",
+	.transfer = dev_transfer,
+	.close = dev_close,
+};
+
+static int transfer(struct i2c_bus *bus, struct i2c_msg *msgs, int n)
+{
+	int ret;
+
+	pthread_mutex_lock(&bus->lock);
+	ret = bus->backend->transfer(bus, msgs, n);
+	bus->transfers++;
+	if (ret < 0)
+		bus->errors++;
+	pthread_mutex_unlock(&bus->lock);
+
+	return ret;
+}
+
+/*
+ * Plain read, for devices without a register pointer.
+ */
+int i2c_read(struct i2c_bus *bus, uint16_t addr, uint8_t *buf, size_t len)
+{
+	struct i2c_msg msg;
+
+	msg.addr = addr;
+	msg.flags = I2C_M_RD;
+	msg.len = len;
+	msg.buf = buf;
+
+	return transfer(bus, &msg, 1);
+}
+
+/*
+ * Read len bytes starting at register reg.
+ */
+int i2c_read_reg(struct i2c_bus *bus, uint16_t addr, uint8_t reg,
+		uint8_t *buf, size_t len)
+{
+	struct i2c_msg msgs[2];
+
+	msgs[0].addr = addr;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg;
+
+	msgs[1].addr = addr;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = len;
+	msgs[1].buf = buf;
+
+	return transfer(bus, msgs, 2);
+}
+
+int i2c_write_reg(struct i2c_bus *bus, uint16_t addr, uint8_t reg,
+		uint8_t value)
+{
+	uint8_t buf[2] = { reg, value };
+
+	return i2c_write(bus, addr, buf, 2);
+}
+
+int i2c_write(struct i2c_bus *bus, uint16_t addr, const uint8_t *buf,
+		size_t len)
+{
+	struct i2c_msg msg;
+
+	msg.addr = addr;
+	msg.flags = 0;
+	msg.len = len;
+	msg.buf = (uint8_t *)buf;
+
+	return transfer(bus, &msg, 1);
+}
+
+static void i2c_close(struct i2c_bus *bus)
+{
+	pthread_mutex_lock(&bus->lock);
+	bus->backend->close(bus);
+	pthread_mutex_unlock(&bus->lock);
+}
+
+/*
+ * Close every bus that was looked up, at shutdown.  A transfer in
+ * progress finishes first.
+ */
+void i2c_close_all(void)
+{
+	int i;
+
+	for (i = 0; i < I2C_MAX_BUS; i++) {
+		if (buses[i].path != NULL)
+			i2c_close(&buses[i]);
+	}
+}
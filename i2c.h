@@ -0,0 +1,69 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * I2C transport.  Keeps the bus device open and does register reads as
+ * one combined transaction, through a backend that is the kernel's
+ * i2c-dev or a simulation.
+ */
+#ifndef I2C_H
+#define I2C_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+struct i2c_msg;
+struct i2c_bus;
+
+/* How transfers reach the bus.  Called with the bus locked. */
+struct i2c_backend {
+	const char *name;
+	int (*transfer)(struct i2c_bus *bus, struct i2c_msg *msgs, int n);
+	void (*close)(struct i2c_bus *bus);
+};
+
+struct i2c_bus {
+	const char *path;
+	const struct i2c_backend *backend;
+	void *priv;		/* backend state */
+	int fd;			/* -1 while closed */
+	int failed;		/* last open failed, don't repeat the message */
+	pthread_mutex_t lock;
+	unsigned long transfers;
+	unsigned long errors;
+	unsigned long opens;
+};
+
+extern const struct i2c_backend i2c_dev_backend;
+
+#define I2C_MAX_BUS	16
+
+struct i2c_bus *i2c_bus_get(int nr);
+int i2c_read(struct i2c_bus *bus, uint16_t addr, uint8_t *buf, size_t len);
+int i2c_read_reg(struct i2c_bus *bus, uint16_t addr, uint8_t reg,
+		uint8_t *buf, size_t len);
+int i2c_write_reg(struct i2c_bus *bus, uint16_t addr, uint8_t reg,
+		uint8_t value);
+int i2c_write(struct i2c_bus *bus, uint16_t addr, const uint8_t *buf,
+		size_t len);
+void i2c_close_all(void);
+
+#endif
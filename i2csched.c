@@ -0,0 +1,389 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * I2C bus scheduler.
+ *
+ * Every bus with devices on it gets a thread that owns them: nothing
+ * else calls their drivers, so transactions on a bus are serialised by
+ * construction.  A device that is asked for a reading is started as
+ * soon as its driver's minimum period allows; while it converts the
+ * thread starts or reads any other device that is due, and sleeps only
+ * until the earliest conversion ends.  Sampling a BMP280 and a TSL2561
+ * together then takes as long as the slower of the two, not the sum.
+ *
+ * Finished readings are handed back through an eventfd watched by the
+ * event loop, so the callbacks run on the main thread.  Without an
+ * event loop (input read from a file, or a benchmark) they are called
+ * from the bus thread.
+ *
+ * i2csched_stop() ends the bus threads, abandoning any reading under
+ * way, so nothing touches a bus after it returns.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "i2csched.h"
+#include "evloop.h"
+
+enum sched_state {
+	SCHED_IDLE,
+	SCHED_WANTED,		/* waiting for its minimum period */
+	SCHED_CONVERTING,
+};
+
+struct sched_bus;
+
+struct i2csched_dev {
+	struct device *dev;
+	struct sched_bus *sb;
+	i2csched_done done;
+	void *arg;
+
+	/* Only the bus thread touches these */
+	enum sched_state state;
+	struct timespec due;		/* start or read time */
+	struct timespec last_start;
+	struct reading r;
+
+	/* Under the lock */
+	int wanted;			/* a reading was asked for */
+	int completed;			/* result waiting to be handed back */
+	int ret;
+	struct reading result;
+};
+
+struct sched_bus {
+	struct i2c_bus *bus;
+	pthread_t thread;
+	pthread_cond_t cond;
+	struct i2csched_dev *devs[I2CSCHED_MAX_DEVS];
+	int ndevs;
+};
+
+static struct i2csched_dev devs[I2CSCHED_MAX_DEVS];
+static int ndevs;
+static struct sched_bus buses[I2CSCHED_MAX_DEVS];
+static int nbuses;
+static int nthreads;			/* bus threads running */
+static int stopping;
+static struct i2csched_stats stats;
+static int efd = -1;
+static struct ev_source *efd_src;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void ts_add_us(struct timespec *ts, unsigned long us)
+{
+	ts->tv_sec += us / 1000000;
+	ts->tv_nsec += (us % 1000000) * 1000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+static int ts_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+		(a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* Hand finished readings to their callbacks */
+static void dispatch(void)
+{
+	struct i2csched_dev *done[I2CSCHED_MAX_DEVS];
+	struct reading r[I2CSCHED_MAX_DEVS];
+	int ret[I2CSCHED_MAX_DEVS];
+	int i, n = 0;
+
+	pthread_mutex_lock(&lock);
+	for (i = 0; i < ndevs; i++) {
+		if (!devs[i].completed)
+			continue;
+		devs[i].completed = 0;
+		done[n] = &devs[i];
+		r[n] = devs[i].result;
+		ret[n] = devs[i].ret;
+		n++;
+	}
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < n; i++)
+		done[i]->done(done[i]->dev, ret[i], &r[i], done[i]->arg);
+}
+
+static void completion_ready(struct ev_source *src, uint32_t events)
+{
+	uint64_t n;
+
+	if (read(efd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		return;
+	dispatch();
+}
+
+static void finish(struct i2csched_dev *sd, int ret)
+{
+	uint64_t one = 1;
+
+	/* Set it up again next time in case it was reset */
+	if (ret < 0)
+		sd->dev->ready = 0;
+	sd->state = SCHED_IDLE;
+
+	pthread_mutex_lock(&lock);
+	sd->ret = ret;
+	sd->result = sd->r;
+	sd->completed = 1;
+	stats.readings++;
+	if (ret < 0)
+		stats.errors++;
+	pthread_mutex_unlock(&lock);
+
+	if (efd < 0)
+		dispatch();
+	else if (write(efd, &one, sizeof(one)) < 0)
+		perror("eventfd");
+}
+
+/* Take a device one step further if it's due */
+static void step(struct i2csched_dev *sd, const struct timespec *now)
+{
+	struct device *dev = sd->dev;
+	int i, ret;
+
+	if (ts_before(now, &sd->due))
+		return;
+
+	if (sd->state == SCHED_WANTED) {
+		if (device_prepare(dev) < 0) {
+			finish(sd, -1);
+			return;
+		}
+
+		pthread_mutex_lock(&lock);
+		for (i = 0; i < sd->sb->ndevs; i++) {
+			if (sd->sb->devs[i]->state == SCHED_CONVERTING) {
+				stats.overlapped++;
+				break;
+			}
+		}
+		stats.conversions++;
+		pthread_mutex_unlock(&lock);
+
+		clock_gettime(CLOCK_MONOTONIC, &sd->last_start);
+		if (dev->drv->start(dev) < 0) {
+			finish(sd, -1);
+			return;
+		}
+		sd->state = SCHED_CONVERTING;
+		sd->due = sd->last_start;
+		ts_add_us(&sd->due, dev->drv->conversion_us(dev));
+	} else if (sd->state == SCHED_CONVERTING) {
+		ret = dev->drv->read(dev, &sd->r);
+		if (ret == 1) {
+			/* Wants another go, with a new range say */
+			sd->state = SCHED_WANTED;
+			sd->due = sd->last_start;
+			ts_add_us(&sd->due, dev->drv->min_period_us(dev));
+			return;
+		}
+		finish(sd, ret);
+	}
+}
+
+static void *bus_thread(void *arg)
+{
+	struct sched_bus *sb = (struct sched_bus *)arg;
+	struct i2csched_dev *sd;
+	struct timespec now, next;
+	int i, active, wanted;
+
+	pthread_mutex_lock(&lock);
+	while (!stopping) {
+		for (i = 0; i < sb->ndevs; i++) {
+			sd = sb->devs[i];
+			if (sd->wanted && sd->state == SCHED_IDLE) {
+				sd->wanted = 0;
+				memset(&sd->r, 0, sizeof(sd->r));
+				sd->state = SCHED_WANTED;
+				/* Not sooner than the driver allows */
+				sd->due = sd->last_start;
+				ts_add_us(&sd->due, sd->dev->drv->min_period_us(sd->dev));
+			}
+		}
+		pthread_mutex_unlock(&lock);
+
+		/* Starting one device can make another due, so go round */
+		do {
+			active = 0;
+			for (i = 0; i < sb->ndevs; i++) {
+				sd = sb->devs[i];
+				if (sd->state == SCHED_IDLE)
+					continue;
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				step(sd, &now);
+				if (sd->state != SCHED_IDLE &&
+						(!active || ts_before(&sd->due, &next))) {
+					next = sd->due;
+					active = 1;
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		} while (active && !ts_before(&now, &next));
+
+		pthread_mutex_lock(&lock);
+		for (i = 0, wanted = 0; i < sb->ndevs; i++) {
+			if (sb->devs[i]->wanted && sb->devs[i]->state == SCHED_IDLE)
+				wanted = 1;
+		}
+		if (wanted)
+			continue;
+		if (active)
+			pthread_cond_timedwait(&sb->cond, &lock, &next);
+		else
+			pthread_cond_wait(&sb->cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+/*
+ * Put a device under the scheduler.  done is called with each reading.
+ * Call before i2csched_start().
+ */
+struct i2csched_dev *i2csched_add(struct device *dev, i2csched_done done,
+		void *arg)
+{
+	struct i2csched_dev *sd;
+	struct sched_bus *sb = NULL;
+	int i;
+
+	if (ndevs == I2CSCHED_MAX_DEVS)
+		return NULL;
+
+	for (i = 0; i < nbuses; i++) {
+		if (buses[i].bus == dev->bus)
+			sb = &buses[i];
+	}
+	if (sb == NULL) {
+		sb = &buses[nbuses++];
+		sb->bus = dev->bus;
+	}
+
+	sd = &devs[ndevs++];
+	sd->dev = dev;
+	sd->sb = sb;
+	sd->done = done;
+	sd->arg = arg;
+	sb->devs[sb->ndevs++] = sd;
+
+	return sd;
+}
+
+/*
+ * Start a thread per bus.  With use_evloop the callbacks are run from
+ * the event loop, which must have been initialised.
+ */
+int i2csched_start(int use_evloop)
+{
+	pthread_condattr_t attr;
+	int i;
+
+	if (use_evloop) {
+		efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (efd < 0) {
+			perror("eventfd");
+			return -1;
+		}
+		efd_src = evloop_add(efd, EPOLLIN, completion_ready, NULL);
+		if (efd_src == NULL)
+			return -1;
+	}
+
+	/* Conversion deadlines are on the monotonic clock */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+	for (i = 0; i < nbuses; i++) {
+		pthread_cond_init(&buses[i].cond, &attr);
+		if (pthread_create(&buses[i].thread, NULL, bus_thread,
+					&buses[i]) != 0) {
+			fprintf(stderr, "Failed to start %s scheduler.\n",
+					buses[i].bus->path);
+			return -1;
+		}
+		nthreads++;
+	}
+	pthread_condattr_destroy(&attr);
+
+	return 0;
+}
+
+/*
+ * Ask for a reading.  Asking again before it starts gets the same one;
+ * asking while it converts gets another after it.
+ */
+void i2csched_request(struct i2csched_dev *sd)
+{
+	pthread_mutex_lock(&lock);
+	sd->wanted = 1;
+	pthread_cond_signal(&sd->sb->cond);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Stop and join the bus threads.  Readings not yet handed back are
+ * dropped.
+ */
+void i2csched_stop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	for (i = 0; i < nthreads; i++)
+		pthread_cond_broadcast(&buses[i].cond);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(buses[i].thread, NULL);
+	nthreads = 0;
+
+	if (efd_src)
+		evloop_del(efd_src);
+	efd_src = NULL;
+	if (efd >= 0)
+		close(efd);
+	efd = -1;
+}
+
+void i2csched_get_stats(struct i2csched_stats *st)
+{
+	pthread_mutex_lock(&lock);
+	*st = stats;
+	pthread_mutex_unlock(&lock);
+}
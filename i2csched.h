@@ -0,0 +1,52 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * I2C bus scheduler.  One thread per bus runs every device on it, so
+ * conversions on different devices overlap instead of queueing.
+ */
+#ifndef I2CSCHED_H
+#define I2CSCHED_H
+
+#include "driver.h"
+
+#define I2CSCHED_MAX_DEVS	8
+
+struct i2csched_dev;
+
+/* A reading finished; ret is 0 with r filled in, or -1 */
+typedef void (*i2csched_done)(struct device *dev, int ret,
+		const struct reading *r, void *arg);
+
+struct i2csched_stats {
+	unsigned long readings;		/* finished, good or not */
+	unsigned long errors;
+	unsigned long conversions;	/* started, including retries */
+	unsigned long overlapped;	/* started while another was converting */
+};
+
+struct i2csched_dev *i2csched_add(struct device *dev, i2csched_done done,
+		void *arg);
+int i2csched_start(int use_evloop);
+void i2csched_request(struct i2csched_dev *sd);
+void i2csched_stop(void);
+void i2csched_get_stats(struct i2csched_stats *st);
+
+#endif
@@ -0,0 +1,442 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Simulated I2C bus.
+ *
+ * i2c_sim_attach() takes over a bus number with a backend that never
+ * touches the kernel.  Transfers are handed to in-process models of a
+ * BMP280 at 0x77 and a TSL2561 at 0x39, which behave like the chips at
+ * the register level: the BMP280 has the datasheet's example
+ * calibration PROM, runs forced conversions for the time the
+ * oversampling asks for and shows it in the status register, and the
+ * TSL2561 integrates for the selected time and scales and clips its
+ * counts by gain and integration time.  The raw values they return
+ * are set in the spec.
+ *
+ * Each transfer can be slowed down by a fixed latency plus a per byte
+ * time, and made to fail at random, so the effect of a slow or noisy
+ * bus on sampling can be measured.
+ *
+ * The spec is a comma separated list of key=value: bus, latency,
+ * byte, errors, seed, adc_t, adc_p, ch0 and ch1.  For example
+ * "bus=1,latency=200,byte=90,errors=100".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/i2c.h>
+#include "i2csim.h"
+#include "driver.h"
+
+struct sim_model;
+
+struct i2c_sim_dev {
+	const struct sim_model *model;
+	struct i2c_sim *sim;
+	uint16_t addr;
+	uint8_t ptr;			/* register pointer */
+	uint8_t regs[256];
+	int busy;			/* converting or integrating */
+	struct timespec busy_until;
+	struct timespec powered;	/* TSL2561 power up time */
+};
+
+struct sim_model {
+	const char *name;
+	uint16_t addr;
+	void (*reset)(struct i2c_sim_dev *d);
+	void (*write)(struct i2c_sim_dev *d, const uint8_t *buf, size_t len);
+	void (*read)(struct i2c_sim_dev *d, uint8_t *buf, size_t len);
+};
+
+static void now_plus(struct timespec *ts, unsigned long us)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += us / 1000000;
+	ts->tv_nsec += (us % 1000000) * 1000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/* Microseconds since ts, negative if it is still to come */
+static long since_us(const struct timespec *ts)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - ts->tv_sec) * 1000000L +
+		(now.tv_nsec - ts->tv_nsec) / 1000;
+}
+
+/*
+ * BMP280
+ */
+#define BMP_CALIB	0x88
+#define BMP_ID		0xD0
+#define BMP_STATUS	0xF3
+#define BMP_CTRL_MEAS	0xF4
+#define BMP_DATA	0xF7
+
+/* Datasheet section 3.12 example, T1..P9 */
+static const uint16_t bmp_calib[12] = {
+	27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024,
+	2855, 140, (uint16_t)-7, 15500, (uint16_t)-14600, 6000,
+};
+
+static void bmp_reset(struct i2c_sim_dev *d)
+{
+	int i;
+
+	memset(d->regs, 0, sizeof(d->regs));
+	for (i = 0; i < 12; i++) {
+		d->regs[BMP_CALIB + 2 * i] = bmp_calib[i] & 0xFF;
+		d->regs[BMP_CALIB + 2 * i + 1] = bmp_calib[i] >> 8;
+	}
+	d->regs[BMP_ID] = 0x58;
+	/* Reset values of the data registers */
+	d->regs[BMP_DATA] = 0x80;
+	d->regs[BMP_DATA + 3] = 0x80;
+}
+
+/* The results appear, and the chip goes back to sleep, at the end */
+static void bmp_update(struct i2c_sim_dev *d)
+{
+	const struct i2c_sim *sim = d->sim;
+
+	if (!d->busy || since_us(&d->busy_until) < 0)
+		return;
+
+	d->regs[BMP_DATA] = (sim->adc_p >> 12) & 0xFF;
+	d->regs[BMP_DATA + 1] = (sim->adc_p >> 4) & 0xFF;
+	d->regs[BMP_DATA + 2] = (sim->adc_p & 0x0F) << 4;
+	d->regs[BMP_DATA + 3] = (sim->adc_t >> 12) & 0xFF;
+	d->regs[BMP_DATA + 4] = (sim->adc_t >> 4) & 0xFF;
+	d->regs[BMP_DATA + 5] = (sim->adc_t & 0x0F) << 4;
+	d->regs[BMP_CTRL_MEAS] &= ~0x03;
+	d->busy = 0;
+}
+
+/* Typical rather than maximum conversion time: 1 + 2 * T + 2 * P + 0.5 ms */
+static unsigned long bmp_conversion_us(uint8_t ctrl_meas)
+{
+	unsigned int t = ctrl_meas >> 5, p = (ctrl_meas >> 2) & 0x07;
+
+	t = t ? 1u << ((t > 5 ? 5 : t) - 1) : 0;
+	p = p ? 1u << ((p > 5 ? 5 : p) - 1) : 0;
+
+	return 1000 + 2000 * t + (p ? 2000 * p + 500 : 0);
+}
+
+static void bmp_write_reg(struct i2c_sim_dev *d, uint8_t reg, uint8_t value)
+{
+	if (reg < BMP_STATUS)
+		return;		/* read only */
+
+	d->regs[reg] = value;
+	if (reg == BMP_CTRL_MEAS && (value & 0x03) && !d->busy) {
+		d->busy = 1;
+		now_plus(&d->busy_until, bmp_conversion_us(value));
+	}
+}
+
+/* Register, value pairs; a lone register just sets the pointer */
+static void bmp_write(struct i2c_sim_dev *d, const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	bmp_update(d);
+	d->ptr = buf[0];
+	for (i = 0; i + 1 < len; i += 2)
+		bmp_write_reg(d, buf[i], buf[i + 1]);
+}
+
+static void bmp_read(struct i2c_sim_dev *d, uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	bmp_update(d);
+	for (i = 0; i < len; i++) {
+		if (d->ptr == BMP_STATUS)
+			buf[i] = d->busy ? 0x08 : 0x00;
+		else
+			buf[i] = d->regs[d->ptr];
+		d->ptr++;
+	}
+}
+
+/*
+ * TSL2561
+ */
+#define TSL_CMD		0x80
+#define TSL_CONTROL	0x00
+#define TSL_TIMING	0x01
+#define TSL_ID		0x0A
+#define TSL_DATA0	0x0C
+
+static const struct {
+	unsigned long us;
+	unsigned int units;	/* of 322 */
+	unsigned int max;
+} tsl_integ[3] = {
+	{ 13700, 11, 5047 },
+	{ 101000, 81, 37177 },
+	{ 402000, 322, 65535 },
+};
+
+static void tsl_reset(struct i2c_sim_dev *d)
+{
+	memset(d->regs, 0, sizeof(d->regs));
+	d->regs[TSL_TIMING] = 0x02;
+	d->regs[TSL_ID] = 0x50;		/* TSL2561T, revision 0 */
+	d->busy = 0;
+}
+
+static unsigned int tsl_counts(const struct i2c_sim_dev *d, unsigned long ref)
+{
+	unsigned int integ = d->regs[TSL_TIMING] & 0x03;
+	unsigned long long counts;
+
+	if (integ > 2)
+		return 0;	/* manual integration isn't modelled */
+
+	counts = (unsigned long long)ref * tsl_integ[integ].units / 322;
+	if (!(d->regs[TSL_TIMING] & 0x10))
+		counts /= 16;
+	if (counts > tsl_integ[integ].max)
+		counts = tsl_integ[integ].max;
+
+	return counts;
+}
+
+/* The ADC registers fill in at the end of the first integration */
+static void tsl_update(struct i2c_sim_dev *d)
+{
+	unsigned int integ = d->regs[TSL_TIMING] & 0x03, ch0, ch1;
+
+	if (!d->busy || integ > 2 ||
+			since_us(&d->powered) < (long)tsl_integ[integ].us)
+		return;
+
+	ch0 = tsl_counts(d, d->sim->ch0);
+	ch1 = tsl_counts(d, d->sim->ch1);
+	d->regs[TSL_DATA0] = ch0 & 0xFF;
+	d->regs[TSL_DATA0 + 1] = ch0 >> 8;
+	d->regs[TSL_DATA0 + 2] = ch1 & 0xFF;
+	d->regs[TSL_DATA0 + 3] = ch1 >> 8;
+}
+
+/* A command byte, optionally followed by a value for its register */
+static void tsl_write(struct i2c_sim_dev *d, const uint8_t *buf, size_t len)
+{
+	uint8_t reg;
+
+	tsl_update(d);
+	if (!(buf[0] & TSL_CMD))
+		return;
+	reg = d->ptr = buf[0] & 0x0F;
+	if (len < 2)
+		return;
+
+	if (reg == TSL_CONTROL) {
+		if ((buf[1] & 0x03) == 0x03 && !d->busy) {
+			d->busy = 1;
+			clock_gettime(CLOCK_MONOTONIC, &d->powered);
+			memset(&d->regs[TSL_DATA0], 0, 4);
+		} else if ((buf[1] & 0x03) == 0) {
+			d->busy = 0;
+		}
+		d->regs[reg] = buf[1] & 0x03;
+	} else if (reg == TSL_TIMING) {
+		d->regs[reg] = buf[1] & 0x1B;
+	}
+}
+
+static void tsl_read(struct i2c_sim_dev *d, uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	tsl_update(d);
+	for (i = 0; i < len; i++) {
+		buf[i] = d->regs[d->ptr & 0x0F];
+		d->ptr++;
+	}
+}
+
+static const struct sim_model models[] = {
+	{ "bmp280", 0x77, bmp_reset, bmp_write, bmp_read },
+	{ "tsl2561", 0x39, tsl_reset, tsl_write, tsl_read },
+};
+
+/*
+ * The backend.  Runs with the bus locked, so the latency holds up any
+ * other device on the same bus, as it would on a real one.
+ */
+static int sim_transfer(struct i2c_bus *bus, struct i2c_msg *msgs, int n)
+{
+	struct i2c_sim *sim = bus->priv;
+	struct i2c_sim_dev *d;
+	unsigned long bytes = 0;
+	int i, j;
+
+	sim->transfers++;
+
+	for (i = 0; i < n; i++)
+		bytes += 1 + msgs[i].len;	/* address byte and data */
+	if (sim->latency_us || sim->byte_us)
+		driver_sleep(sim->latency_us + sim->byte_us * bytes);
+
+	if (sim->error_rate && rand_r(&sim->seed) % sim->error_rate == 0) {
+		sim->injected++;
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = 0, d = NULL; j < sim->ndevs; j++) {
+			if (sim->devs[j]->addr == msgs[i].addr)
+				d = sim->devs[j];
+		}
+		if (d == NULL || msgs[i].len == 0)
+			return -1;	/* no acknowledge */
+
+		if (msgs[i].flags & I2C_M_RD)
+			d->model->read(d, msgs[i].buf, msgs[i].len);
+		else
+			d->model->write(d, msgs[i].buf, msgs[i].len);
+	}
+
+	return 0;
+}
+
+static void sim_close(struct i2c_bus *bus)
+{
+}
+
+static const struct i2c_backend sim_backend = {
+	.name = "sim",
+	.transfer = sim_transfer,
+	.close = sim_close,
+};
+
+static int set_option(struct i2c_sim *sim, int *bus_nr, const char *key,
+		size_t klen, long value)
+{
+	static const struct {
+		const char *key;
+		size_t offset;
+		int is_long;
+	} options[] = {
+		{ "latency", offsetof(struct i2c_sim, latency_us), 0 },
+		{ "byte", offsetof(struct i2c_sim, byte_us), 0 },
+		{ "errors", offsetof(struct i2c_sim, error_rate), 0 },
+		{ "seed", offsetof(struct i2c_sim, seed), 0 },
+		{ "adc_t", offsetof(struct i2c_sim, adc_t), 0 },
+		{ "adc_p", offsetof(struct i2c_sim, adc_p), 0 },
+		{ "ch0", offsetof(struct i2c_sim, ch0), 1 },
+		{ "ch1", offsetof(struct i2c_sim, ch1), 1 },
+	};
+	size_t i;
+
+	if (klen == 3 && strncmp(key, "bus", 3) == 0) {
+		*bus_nr = value;
+		return 0;
+	}
+
+	for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+		if (strlen(options[i].key) != klen ||
+				strncmp(options[i].key, key, klen) != 0)
+			continue;
+		if (options[i].is_long)
+			*(unsigned long *)((char *)sim + options[i].offset) = value;
+		else
+			*(unsigned int *)((char *)sim + options[i].offset) = value;
+		return 0;
+	}
+
+	return -1;
+}
+
+/*
+ * Put a simulated bus in place of /dev/i2c-N as described by spec.
+ * Call before the bus is used.
+ */
+struct i2c_sim *i2c_sim_attach(const char *spec)
+{
+	struct i2c_sim *sim;
+	struct i2c_bus *bus;
+	const char *p = spec, *eq, *end;
+	int bus_nr = 1;
+	long value;
+	char *vend;
+	size_t i;
+
+	sim = calloc(1, sizeof(*sim));
+	if (sim == NULL)
+		return NULL;
+	sim->seed = 1;
+	sim->adc_t = 519888;	/* the datasheet example, 25.08 C */
+	sim->adc_p = 415148;	/* and 1006.53 hPa */
+	sim->ch0 = 1000;	/* about 24 lux */
+	sim->ch1 = 200;
+
+	while (*p) {
+		end = strchr(p, ',');
+		if (end == NULL)
+			end = p + strlen(p);
+		eq = memchr(p, '=', end - p);
+		if (eq == NULL)
+			goto bad;
+		value = strtol(eq + 1, &vend, 0);
+		if (vend != end || value < 0 ||
+				set_option(sim, &bus_nr, p, eq - p, value) < 0)
+			goto bad;
+		p = *end ? end + 1 : end;
+	}
+
+	bus = i2c_bus_get(bus_nr);
+	if (bus == NULL)
+		goto bad;
+
+	for (i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+		sim->devs[i] = calloc(1, sizeof(struct i2c_sim_dev));
+		if (sim->devs[i] == NULL)
+			goto bad;
+		sim->devs[i]->model = &models[i];
+		sim->devs[i]->sim = sim;
+		sim->devs[i]->addr = models[i].addr;
+		models[i].reset(sim->devs[i]);
+		sim->ndevs++;
+	}
+
+	bus->backend = &sim_backend;
+	bus->priv = sim;
+
+	return sim;
+
+bad:
+	fprintf(stderr, "Bad I2C simulation spec %s.\n", spec);
+	for (i = 0; i < (size_t)sim->ndevs; i++)
+		free(sim->devs[i]);
+	free(sim);
+	return NULL;
+}
@@ -0,0 +1,57 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Simulated I2C bus with register level models of the BMP280 and
+ * TSL2561, for exercising the sensor drivers and sampler without
+ * hardware.
+ */
+#ifndef I2CSIM_H
+#define I2CSIM_H
+
+#include <stdint.h>
+#include "i2c.h"
+
+#define I2CSIM_MAX_DEVS	4
+
+struct i2c_sim_dev;
+
+struct i2c_sim {
+	/* Injected on every transfer */
+	unsigned int latency_us;	/* per transfer */
+	unsigned int byte_us;		/* per byte, 90 is 100 kHz */
+	unsigned int error_rate;	/* fail 1 in this many, 0 for none */
+	unsigned int seed;
+
+	/* What the sensors see */
+	int32_t adc_t;			/* BMP280 20 bit raw values */
+	int32_t adc_p;
+	unsigned long ch0;		/* TSL2561 counts at 16x, 402 ms */
+	unsigned long ch1;
+
+	struct i2c_sim_dev *devs[I2CSIM_MAX_DEVS];
+	int ndevs;
+	unsigned long transfers;
+	unsigned long injected;		/* errors injected */
+};
+
+struct i2c_sim *i2c_sim_attach(const char *spec);
+
+#endif
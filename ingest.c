@@ -0,0 +1,166 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Line oriented input from rtl_433.
+ *
+ * The buffer holds at most one partial line plus any number of complete
+ * lines.  Lines are found with memchr() and terminated in place by
+ * replacing the newline with a '\0', so the pointer handed out stays
+ * valid until the next call to ingest_fill().  When the space at the
+ * end of the buffer runs out, the partial line is moved back to the
+ * start; the buffer only grows when a single line is larger than the
+ * whole buffer.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "ingest.h"
+
+int ingest_init(struct ingest *in, int fd, size_t size)
+{
+	memset(in, 0, sizeof(struct ingest));
+
+	in->buf = (char *)malloc(size);
+	if (in->buf == NULL)
+		return -1;
+
+	in->fd = fd;
+	in->size = size;
+	return 0;
+}
+
+void ingest_free(struct ingest *in)
+{
+	free(in->buf);
+	in->buf = NULL;
+	in->size = 0;
+}
+
+/*
+ * Do one read() into the free space of the buffer. Returns the number
+ * of bytes read, 0 at end of file or -1 with errno set.  One byte is
+ * always kept free so the last line can be terminated even when the
+ * input does not end with a newline.
+ */
+ssize_t ingest_fill(struct ingest *in)
+{
+	ssize_t n;
+	char *nbuf;
+
+	if (in->head == in->tail) {
+		in->head = 0;
+		in->tail = 0;
+		in->scan = 0;
+	}
+
+	if (in->tail + 1 >= in->size) {
+		if (in->head > 0) {
+			/* Move the partial line back to the start */
+			memmove(in->buf, in->buf + in->head, in->tail - in->head);
+			in->tail -= in->head;
+			in->scan -= in->head;
+			in->head = 0;
+		} else {
+			/* A single line fills the whole buffer */
+			nbuf = (char *)realloc(in->buf, in->size * 2);
+			if (nbuf == NULL) {
+				errno = ENOMEM;
+				return -1;
+			}
+			in->buf = nbuf;
+			in->size *= 2;
+		}
+	}
+
+	n = read(in->fd, in->buf + in->tail, in->size - in->tail - 1);
+	if (n > 0)
+		in->tail += n;
+	else if (n == 0)
+		in->eof = 1;
+
+	return n;
+}
+
+/*
+ * Return the next complete line that is already in the buffer.
+ * Leading white space, a trailing carriage return and empty lines
+ * are skipped.  Returns 1 if a line was found, 0 if more input is
+ * needed (or the input is exhausted).
+ */
+int ingest_next(struct ingest *in, char **line, size_t *len)
+{
+	char *start, *end, *nl;
+
+	while (in->head < in->tail) {
+		nl = (char *)memchr(in->buf + in->scan, '\n',
+				in->tail - in->scan);
+		if (nl == NULL) {
+			in->scan = in->tail;
+			if (!in->eof)
+				return 0;
+
+			/* Last line without a newline */
+			nl = in->buf + in->tail;
+			in->tail++;
+		}
+
+		start = in->buf + in->head;
+		end = nl;
+		in->head = (size_t)(nl - in->buf) + 1;
+		in->scan = in->head;
+
+		while (start < end && (*start == ' ' || *start == '\t'))
+			start++;
+		if (end > start && end[-1] == '\r')
+			end--;
+		*end = '\0';
+
+		if (end > start) {
+			*line = start;
+			*len = (size_t)(end - start);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Blocking version of ingest_next().  Returns 1 when a line is
+ * available, 0 at end of input and -1 on a read error.
+ */
+int ingest_getline(struct ingest *in, char **line, size_t *len)
+{
+	ssize_t n;
+
+	for (;;) {
+		if (ingest_next(in, line, len))
+			return 1;
+
+		if (in->eof)
+			return 0;
+
+		n = ingest_fill(in);
+		if (n < 0 && errno != EINTR)
+			return -1;
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Line oriented input from rtl_433.  Data is pulled from a file
+ * descriptor with large read() calls into a reusable buffer and split
+ * into lines in place, so each line can be handed to the JSON parser
+ * without copying and without a fixed line length limit.
+ */
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define INGEST_BUFSIZE	(64 * 1024)
+
+struct ingest {
+	int fd;
+	char *buf;
+	size_t size;	/* allocated size of buf */
+	size_t head;	/* start of the first unconsumed line */
+	size_t tail;	/* end of valid data */
+	size_t scan;	/* where the next newline search resumes */
+	int eof;
+};
+
+int ingest_init(struct ingest *in, int fd, size_t size);
+void ingest_free(struct ingest *in);
+ssize_t ingest_fill(struct ingest *in);
+int ingest_next(struct ingest *in, char **line, size_t *len);
+int ingest_getline(struct ingest *in, char **line, size_t *len);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Reader / parser / publisher pipeline.
+ *
+ * Lines are copied out of the input buffer into a slot of the line
+ * ring, so the reader can go straight back to reading.  The rare line
+ * longer than a slot is copied to the heap instead and the parse
+ * thread frees it.  The parse
+ * thread owns everything the decoders touch (sensor table, parser
+ * arena), which is why periodic work on that state is sent down the
+ * line ring with pipeline_call() rather than run from the reader's
+ * timers.  Every slot carries the time it belongs to when replaying,
+ * and the parse thread sets the virtual clock from it before handling
+ * the slot.  Packets are serialized straight into slots of the packet
+ * ring and the publish thread sends them from there, batching whatever
+ * is queued whenever it catches up.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pipeline.h"
+#include "sender.h"
+#include "vclock.h"
+
+enum slot_kind {
+	SLOT_LINE,
+	SLOT_CALL,
+	SLOT_STOP,
+};
+
+struct line_slot {
+	enum slot_kind kind;
+	void (*call)(void);
+	time_t when;
+	size_t len;
+	char *heap;		/* a line too long for the slot, or NULL */
+	char line[PIPE_LINE_MAX];
+};
+
+static struct ring lines;
+static struct ring packets;
+static pipe_line_fn line_handler;
+static pthread_t parse_thread;
+static pthread_t publish_thread;
+static atomic_int stopping;
+static unsigned long long_lines;
+
+static void *parse_stage(void *arg)
+{
+	struct line_slot *slot;
+	struct wf_packet *pkt;
+
+	for (;;) {
+		slot = (struct line_slot *)ring_take(&lines);
+		if (slot->when != PIPE_LIVE)
+			vclock_set(slot->when);
+
+		switch (slot->kind) {
+			case SLOT_LINE:
+				if (slot->heap) {
+					line_handler(slot->heap, slot->len);
+					free(slot->heap);
+					slot->heap = NULL;
+				} else {
+					line_handler(slot->line, slot->len);
+				}
+				break;
+			case SLOT_CALL:
+				slot->call();
+				break;
+			case SLOT_STOP:
+				ring_release(&lines, slot);
+				/* An empty packet wakes the publisher to stop */
+				atomic_store(&stopping, 1);
+				pkt = pipeline_packet();
+				pkt->len = 0;
+				pipeline_publish(pkt);
+				return NULL;
+		}
+		ring_release(&lines, slot);
+	}
+}
+
+/* Send what has been queued and give the packets back */
+static void flush(struct wf_packet **held, int *nheld)
+{
+	sender_flush();
+	while (*nheld > 0)
+		ring_release(&packets, held[--*nheld]);
+}
+
+/*
+ * The sender points straight at the packet slots, so they are held
+ * until the batch they are in has gone out.
+ */
+static void *publish_stage(void *arg)
+{
+	struct wf_packet *held[SENDER_BATCH];
+	struct wf_packet *pkt;
+	int nheld = 0, n;
+
+	for (;;) {
+		pkt = (struct wf_packet *)ring_poll(&packets);
+		if (pkt == NULL) {
+			/* Caught up, send what has been queued */
+			flush(held, &nheld);
+			pkt = (struct wf_packet *)ring_take(&packets);
+		}
+
+		if (pkt->len == 0) {
+			ring_release(&packets, pkt);
+			if (atomic_load(&stopping))
+				break;
+			continue;
+		}
+
+		n = sender_queue(pkt->buf, pkt->len);
+		if (n < 0) {
+			ring_release(&packets, pkt);
+			continue;
+		}
+		held[nheld++] = pkt;
+		if (n == SENDER_BATCH)
+			flush(held, &nheld);
+	}
+
+	flush(held, &nheld);
+
+	return NULL;
+}
+
+/*
+ * Get a line slot to fill.  Slots come back from the parse stage with
+ * no heap line; one reclaimed unread from a full queue may still have
+ * one.
+ */
+static struct line_slot *get_slot(void)
+{
+	struct line_slot *slot = (struct line_slot *)ring_get(&lines);
+
+	if (slot->heap) {
+		free(slot->heap);
+		slot->heap = NULL;
+	}
+
+	return slot;
+}
+
+/*
+ * Start the parse and publish threads.  handler is called on the parse
+ * thread for every line.
+ */
+int pipeline_start(enum ring_policy policy, pipe_line_fn handler)
+{
+	line_handler = handler;
+	atomic_init(&stopping, 0);
+
+	if (ring_init(&lines, PIPE_LINES, sizeof(struct line_slot),
+				policy) < 0 ||
+			ring_init(&packets, PIPE_PACKETS,
+				sizeof(struct wf_packet), policy) < 0) {
+		fprintf(stderr, "Failed to allocate pipeline.\n");
+		return -1;
+	}
+
+	if (pthread_create(&parse_thread, NULL, parse_stage, NULL) != 0 ||
+			pthread_create(&publish_thread, NULL, publish_stage,
+				NULL) != 0) {
+		fprintf(stderr, "Failed to start pipeline threads.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Let both stages finish what is queued and wait for them.
+ */
+void pipeline_stop(void)
+{
+	struct line_slot *slot;
+
+	slot = get_slot();
+	slot->kind = SLOT_STOP;
+	slot->when = PIPE_LIVE;
+	ring_put(&lines, slot);
+
+	pthread_join(parse_thread, NULL);
+	pthread_join(publish_thread, NULL);
+}
+
+/*
+ * Queue a line for the parse stage.  when is the recorded time of the
+ * line, or PIPE_LIVE.  Lines that don't fit a slot are copied to the
+ * heap and freed by the parse stage.
+ */
+void pipeline_line(const char *line, size_t len, time_t when)
+{
+	struct line_slot *slot;
+	char *heap = NULL, *dst;
+
+	if (len >= PIPE_LINE_MAX) {
+		heap = (char *)malloc(len + 1);
+		if (heap == NULL) {
+			perror("Dropping a long line");
+			return;
+		}
+		long_lines++;
+	}
+
+	slot = get_slot();
+	slot->heap = heap;
+	dst = heap ? heap : slot->line;
+	slot->kind = SLOT_LINE;
+	slot->when = when;
+	slot->len = len;
+	memcpy(dst, line, len);
+	dst[len] = '\0';
+	ring_put(&lines, slot);
+}
+
+/*
+ * Run fn on the parse thread, in order with the lines around it.
+ */
+void pipeline_call(void (*fn)(void), time_t when)
+{
+	struct line_slot *slot;
+
+	slot = get_slot();
+	slot->kind = SLOT_CALL;
+	slot->call = fn;
+	slot->when = when;
+	ring_put(&lines, slot);
+}
+
+/*
+ * Get a packet to serialize into.  Every packet obtained this way must
+ * be handed to pipeline_publish(); one left with len 0 is not sent.
+ */
+struct wf_packet *pipeline_packet(void)
+{
+	return (struct wf_packet *)ring_get(&packets);
+}
+
+void pipeline_publish(struct wf_packet *pkt)
+{
+	ring_put(&packets, pkt);
+}
+
+void pipeline_get_stats(struct pipeline_stats *stats)
+{
+	ring_get_stats(&lines, &stats->lines);
+	ring_get_stats(&packets, &stats->packets);
+	stats->long_lines = long_lines;
+}
@@ -0,0 +1,62 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Three stage pipeline.  The main thread reads input, a parse thread
+ * decodes lines into packets and a publish thread sends them.  The
+ * stages are linked by SPSC rings so a slow stage only backs up its own
+ * queue.
+ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <time.h>
+#include "ring.h"
+#include "wfpacket.h"
+
+#define PIPE_LINE_MAX	4096	/* longer lines go through the heap */
+#define PIPE_LINES	128	/* line slots between reader and parser */
+#define PIPE_PACKETS	128	/* packet slots between parser and publisher */
+
+#define PIPE_LIVE	((time_t)-1)	/* not replayed, use the wall clock */
+
+typedef void (*pipe_line_fn)(char *line, size_t len);
+
+struct pipeline_stats {
+	struct ring_stats lines;
+	struct ring_stats packets;
+	unsigned long long_lines;	/* lines that didn't fit a slot */
+};
+
+int pipeline_start(enum ring_policy policy, pipe_line_fn handler);
+void pipeline_stop(void);
+
+/* Reader side */
+void pipeline_line(const char *line, size_t len, time_t when);
+void pipeline_call(void (*fn)(void), time_t when);
+
+/* Parse side */
+struct wf_packet *pipeline_packet(void);
+void pipeline_publish(struct wf_packet *pkt);
+
+void pipeline_get_stats(struct pipeline_stats *stats);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Predictive sampling.
+ *
+ * The Acurite sensors transmit on a fixed period, so once a few
+ * messages have been seen the next one can be expected to within a few
+ * tens of milliseconds.  Every source (a sensor and the local readings
+ * its messages carry, so a 5-in-1's type 56 and 49 messages are
+ * followed separately) keeps its period, smoothed over the intervals
+ * between its arrivals, and the phase given by its last arrival.  An
+ * interval that is close to a whole number of periods counts towards
+ * the period; anything else means the sensor was reset or replaced and
+ * the period is learned again.
+ *
+ * One timerfd in the event loop is armed for the earliest refresh due.
+ * A refresh is started the sampler's measured latency for those
+ * readings, plus twice the arrival jitter and a margin, ahead of the
+ * expected arrival.  The reading is then in the cache when the message
+ * lands, instead of being up to a sample period old.  A source that
+ * goes quiet for PREDICT_MAX_MISSED periods stops being refreshed
+ * until it is heard from again.
+ *
+ * Arrivals are reported from the parse thread; the timer runs on the
+ * main thread.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include "predict.h"
+#include "sampler.h"
+#include "evloop.h"
+
+struct source {
+	uint64_t key;
+	unsigned int kinds;		/* 0 if the slot is free */
+	long long last;			/* last arrival, ms */
+	double period;			/* ms, 0 until there are two arrivals */
+	double jitter;			/* mean distance from the prediction, ms */
+	int confidence;			/* intervals in a row that fitted */
+	long long expect;		/* next arrival, ms */
+	long long wake;			/* refresh for it, 0 if none */
+	long long fired;		/* refresh started since the last arrival */
+};
+
+static struct source sources[PREDICT_SOURCES];
+static struct predict_stats stats;
+static int tfd = -1;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Arm the timer for the earliest refresh.  Call locked. */
+static void rearm(void)
+{
+	struct itimerspec its;
+	long long wake = 0;
+	int i;
+
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		if (sources[i].wake && (!wake || sources[i].wake < wake))
+			wake = sources[i].wake;
+	}
+
+	/* A zero it_value disarms it */
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = wake / 1000;
+	its.it_value.tv_nsec = (wake % 1000) * 1000000L;
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		perror("timerfd_settime");
+}
+
+/*
+ * Plan the refresh for the next expected arrival after now, or none if
+ * the source isn't predictable or has been quiet too long.  Call
+ * locked.
+ */
+static void schedule(struct source *s, long long now)
+{
+	long long lead;
+
+	s->wake = 0;
+	if (s->confidence < PREDICT_CONFIDENCE)
+		return;
+
+	lead = sampler_latency_ms(s->kinds) + 2 * (long long)s->jitter +
+		PREDICT_MARGIN_MS;
+	while (s->expect - lead <= now) {
+		s->expect += (long long)s->period;
+		if (s->expect > s->last + PREDICT_MAX_MISSED * s->period)
+			return;
+	}
+	s->wake = s->expect - lead;
+}
+
+/* Fit a new arrival into the source's period.  Call locked. */
+static void learn(struct source *s, long long now)
+{
+	double interval = now - s->last, err;
+	int n;
+
+	if (s->period == 0) {
+		s->period = interval;
+		return;
+	}
+
+	/* Messages that were missed leave a multiple of the period */
+	n = (int)(interval / s->period + 0.5);
+	err = interval - n * s->period;
+	if (n >= 1 && n <= PREDICT_MAX_MISSED &&
+			fabs(err) < s->period / 20 + 200) {
+		s->period += (interval / n - s->period) / 8;
+		s->jitter += (fabs(err) - s->jitter) / 8;
+		if (s->confidence < PREDICT_CONFIDENCE)
+			s->confidence++;
+	} else {
+		s->period = interval;
+		s->jitter = 0;
+		s->confidence = 0;
+	}
+}
+
+static struct source *find(uint64_t key, unsigned int kinds)
+{
+	struct source *s, *oldest = &sources[0];
+	int i;
+
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		s = &sources[i];
+		if (s->kinds == kinds && s->key == key)
+			return s;
+		if (s->kinds == 0 || (oldest->kinds && s->last < oldest->last))
+			oldest = s;
+	}
+
+	/* Forget whichever was heard from longest ago */
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->key = key;
+	oldest->kinds = kinds;
+
+	return oldest;
+}
+
+static void timer_ready(struct ev_source *src, uint32_t events)
+{
+	struct source *s;
+	unsigned int kinds = 0;
+	uint64_t expirations;
+	long long now;
+	int i;
+
+	if (read(tfd, &expirations, sizeof(expirations)) < 0)
+		return;
+
+	pthread_mutex_lock(&lock);
+	now = now_ms();
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		s = &sources[i];
+		if (!s->wake || s->wake > now)
+			continue;
+		if (s->fired)
+			stats.missed++;
+		kinds |= s->kinds;
+		s->fired = now;
+		stats.prefetches++;
+		schedule(s, now);
+	}
+	rearm();
+	pthread_mutex_unlock(&lock);
+
+	if (kinds)
+		sampler_refresh(kinds, -1);
+}
+
+/*
+ * Watch for arrivals.  The event loop must have been initialised and
+ * the sampler started.
+ */
+int predict_start(void)
+{
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (tfd < 0) {
+		perror("timerfd_create");
+		return -1;
+	}
+	if (!evloop_add(tfd, EPOLLIN, timer_ready, NULL)) {
+		close(tfd);
+		tfd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * A message from sensor key that is published with the readings in
+ * kinds has arrived.  Does nothing unless predict_start() was called.
+ */
+void predict_arrival(uint64_t key, unsigned int kinds)
+{
+	struct source *s;
+	long long now;
+	int i;
+
+	kinds &= sampler_provided();
+	if (tfd < 0 || kinds == 0)
+		return;
+
+	pthread_mutex_lock(&lock);
+	now = now_ms();
+	s = find(key, kinds);
+	if (s->last && now - s->last < PREDICT_REPEAT_MS) {
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+
+	stats.arrivals++;
+	if (s->fired) {
+		stats.prefetched++;
+		stats.lead_ms += now - s->fired;
+		s->fired = 0;
+	}
+
+	if (s->last)
+		learn(s, now);
+	s->last = now;
+	s->expect = now;
+	schedule(s, now);
+	rearm();
+
+	for (i = 0, stats.sources = 0; i < PREDICT_SOURCES; i++) {
+		if (sources[i].confidence >= PREDICT_CONFIDENCE)
+			stats.sources++;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void predict_get_stats(struct predict_stats *st)
+{
+	pthread_mutex_lock(&lock);
+	*st = stats;
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,50 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Predictive sampling.  Learns when each radio sensor transmits and
+ * refreshes the local readings it is published with just before its
+ * next message is due.
+ */
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stdint.h>
+
+#define PREDICT_SOURCES		32	/* sensors followed at once */
+#define PREDICT_REPEAT_MS	500	/* closer arrivals are one transmission */
+#define PREDICT_CONFIDENCE	2	/* intervals agreeing before predicting */
+#define PREDICT_MAX_MISSED	4	/* periods without a message to give up */
+#define PREDICT_MARGIN_MS	50	/* on top of sampler latency and jitter */
+
+struct predict_stats {
+	unsigned long arrivals;
+	unsigned long prefetched;	/* arrivals a refresh was started for */
+	unsigned long prefetches;	/* refreshes started */
+	unsigned long missed;		/* expected messages that didn't come */
+	unsigned long lead_ms;		/* total, refresh start to arrival */
+	int sources;			/* with a learned period */
+};
+
+int predict_start(void);
+void predict_arrival(uint64_t key, unsigned int kinds);
+void predict_get_stats(struct predict_stats *st);
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Capture recorder.
+ *
+ * record_line() formats a record into the active one of two buffers
+ * and returns; a writer thread writes the other buffer out.  When the
+ * writer is done it takes the active buffer, either because it filled
+ * up or because a second passed, and the reader carries on in the
+ * empty one.  The reader never waits for the disk: if both buffers are
+ * full the line is dropped and counted.
+ *
+ * The file is appended to.  Once it grows past max_size it is moved to
+ * path.N, with N one past the highest already there, and a new file is
+ * started, so a long recording is never overwritten.  The move is a
+ * link() and unlink() rather than rename(), so a path.N that appeared
+ * since is skipped over instead of replaced.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "record.h"
+
+static const char *rec_path;
+static size_t rec_max;
+static int rec_fd = -1;
+static size_t rec_size;
+static unsigned int rec_next;		/* suffix for the next rotation */
+
+static char *bufs[2];
+static size_t lens[2];
+static int active;
+static int pending;			/* the other buffer is being written */
+static int closing;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_t writer;
+static int recording;
+static struct record_stats stats;
+
+static int open_file(void)
+{
+	struct stat sb;
+
+	rec_fd = open(rec_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+			0644);
+	if (rec_fd < 0) {
+		perror(rec_path);
+		return -1;
+	}
+
+	rec_size = (fstat(rec_fd, &sb) == 0) ? sb.st_size : 0;
+
+	return 0;
+}
+
+/* The writer's counters; record_get_stats() reads them under lock */
+static void count_file(void)
+{
+	pthread_mutex_lock(&lock);
+	stats.files++;
+	pthread_mutex_unlock(&lock);
+}
+
+static void count_error(void)
+{
+	pthread_mutex_lock(&lock);
+	stats.errors++;
+	pthread_mutex_unlock(&lock);
+}
+
+static void rotate(void)
+{
+	char name[4096];
+	int ret;
+
+	close(rec_fd);
+	do {
+		snprintf(name, sizeof(name), "%s.%u", rec_path, rec_next++);
+		ret = link(rec_path, name);
+	} while (ret < 0 && errno == EEXIST);
+
+	if (ret < 0 || unlink(rec_path) < 0)
+		perror(name);
+	else
+		count_file();
+
+	if (open_file() < 0)
+		count_error();
+}
+
+static void write_buf(const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0 && rec_fd >= 0) {
+		n = write(rec_fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			count_error();
+			return;
+		}
+		buf += n;
+		len -= n;
+		rec_size += n;
+	}
+
+	if (rec_fd >= 0 && rec_size >= rec_max)
+		rotate();
+}
+
+static void *writer_thread(void *arg)
+{
+	struct timespec deadline;
+	int idx;
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (!pending) {
+			if (lens[active] && closing) {
+				pending = 1;
+				active ^= 1;
+				break;
+			}
+			if (closing)
+				goto done;
+
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec++;
+			if (pthread_cond_timedwait(&wake, &lock, &deadline) ==
+					ETIMEDOUT && !pending && lens[active]) {
+				/* Don't sit on a quiet trickle of lines */
+				pending = 1;
+				active ^= 1;
+			}
+		}
+
+		idx = active ^ 1;
+		pthread_mutex_unlock(&lock);
+
+		write_buf(bufs[idx], lens[idx]);
+
+		pthread_mutex_lock(&lock);
+		lens[idx] = 0;
+		pending = 0;
+	}
+
+done:
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+/*
+ * The highest N of the path.N files in path's directory, 0 if there are
+ * none.  Gaps left by deleted files don't matter.
+ */
+static unsigned int last_rotated(const char *path)
+{
+	const char *base = strrchr(path, '/');
+	char dir[4096], *end;
+	struct dirent *de;
+	unsigned long n;
+	unsigned int last = 0;
+	size_t blen;
+	DIR *d;
+
+	if (base == NULL) {
+		strcpy(dir, ".");
+		base = path;
+	} else {
+		snprintf(dir, sizeof(dir), "%.*s",
+				base == path ? 1 : (int)(base - path), path);
+		base++;
+	}
+	blen = strlen(base);
+
+	d = opendir(dir);
+	if (d == NULL)
+		return 0;
+	while ((de = readdir(d)) != NULL) {
+		if (strncmp(de->d_name, base, blen) != 0 ||
+				de->d_name[blen] != '.' ||
+				de->d_name[blen + 1] < '0' || de->d_name[blen + 1] > '9')
+			continue;
+		n = strtoul(de->d_name + blen + 1, &end, 10);
+		if (*end == '\0' && n > last && n < 0xffffffffUL)
+			last = n;
+	}
+	closedir(d);
+
+	return last;
+}
+
+/*
+ * Start recording to path.  max_size is in bytes.
+ */
+int record_open(const char *path, size_t max_size)
+{
+	rec_path = path;
+	rec_max = max_size;
+
+	/* Carry on numbering after the files a previous run rotated out */
+	rec_next = last_rotated(path) + 1;
+
+	bufs[0] = (char *)malloc(RECORD_BUFSIZE);
+	bufs[1] = (char *)malloc(RECORD_BUFSIZE);
+	if (bufs[0] == NULL || bufs[1] == NULL) {
+		fprintf(stderr, "Failed to allocate capture buffers.\n");
+		return -1;
+	}
+
+	if (open_file() < 0)
+		return -1;
+
+	if (pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+		fprintf(stderr, "Failed to start capture writer.\n");
+		close(rec_fd);
+		rec_fd = -1;
+		return -1;
+	}
+	recording = 1;
+
+	return 0;
+}
+
+/*
+ * Record a line as it was read.  Both timestamps are taken here so the
+ * capture has the times the lines arrived, not when they were written.
+ */
+void record_line(const char *line, size_t len)
+{
+	struct timespec wall, mono;
+	char head[64];
+	size_t hlen, need;
+	char *p;
+
+	if (!recording)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &wall);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	hlen = snprintf(head, sizeof(head), "{\"ts\":%ld.%03ld,\"mono\":%ld.%03ld,"
+			"\"line\":", (long)wall.tv_sec, wall.tv_nsec / 1000000,
+			(long)mono.tv_sec, mono.tv_nsec / 1000000);
+	need = hlen + len + 2;
+
+	pthread_mutex_lock(&lock);
+	if (lens[active] + need > RECORD_BUFSIZE && !pending && lens[active]) {
+		pending = 1;
+		active ^= 1;
+		pthread_cond_signal(&wake);
+	}
+
+	if (lens[active] + need > RECORD_BUFSIZE) {
+		stats.dropped++;
+	} else {
+		p = bufs[active] + lens[active];
+		memcpy(p, head, hlen);
+		memcpy(p + hlen, line, len);
+		p[hlen + len] = '}';
+		p[hlen + len + 1] = '\n';
+		lens[active] += need;
+		stats.lines++;
+		stats.bytes += need;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Write out what is buffered and stop the writer.
+ */
+void record_close(void)
+{
+	if (!recording)
+		return;
+
+	pthread_mutex_lock(&lock);
+	recording = 0;
+	closing = 1;
+	pthread_cond_signal(&wake);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(writer, NULL);
+
+	if (rec_fd >= 0)
+		close(rec_fd);
+	rec_fd = -1;
+	free(bufs[0]);
+	free(bufs[1]);
+	bufs[0] = bufs[1] = NULL;
+}
+
+/*
+ * The write error and rotation counts lag what has been queued until
+ * record_close() has flushed it.
+ */
+void record_get_stats(struct record_stats *st)
+{
+	pthread_mutex_lock(&lock);
+	*st = stats;
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,46 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Capture recorder.  Tees raw input lines, with the time they were
+ * read, into a capture file that --replay can play back.
+ */
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+
+#define RECORD_BUFSIZE		(256 * 1024)
+#define RECORD_MAXSIZE		64	/* default MB per file before rotating */
+
+struct record_stats {
+	unsigned long lines;
+	unsigned long bytes;
+	unsigned long dropped;	/* lines lost because the writer fell behind */
+	unsigned long errors;	/* failed writes */
+	unsigned int files;	/* files rotated out */
+};
+
+int record_open(const char *path, size_t max_size);
+void record_line(const char *line, size_t len);
+void record_close(void);
+void record_get_stats(struct record_stats *stats);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Capture file reader.
+ *
+ * The whole capture is mapped and records are handed out as pointers
+ * into the mapping, so reading costs nothing beyond the page faults.
+ * Only the small wrapper around each line is parsed here; the line
+ * itself goes to the decoders untouched.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "replay.h"
+
+int replay_open(struct replay *rp, const char *path)
+{
+	struct stat sb;
+	int fd;
+
+	memset(rp, 0, sizeof(*rp));
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	if (fstat(fd, &sb) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	rp->size = sb.st_size;
+	if (rp->size) {
+		rp->map = (char *)mmap(NULL, rp->size, PROT_READ, MAP_PRIVATE,
+				fd, 0);
+		if (rp->map == MAP_FAILED) {
+			perror(path);
+			rp->map = NULL;
+			close(fd);
+			return -1;
+		}
+		madvise(rp->map, rp->size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	return 0;
+}
+
+void replay_close(struct replay *rp)
+{
+	if (rp->map)
+		munmap(rp->map, rp->size);
+	rp->map = NULL;
+}
+
+/*
+ * Match "key": at p and read the number after it.  Returns a pointer
+ * past the number, or NULL.
+ */
+static const char *scan_time(const char *p, const char *end, const char *key,
+		double *val)
+{
+	size_t klen = strlen(key);
+	char tmp[32];
+	char *e;
+	size_t n;
+
+	if ((size_t)(end - p) < klen || memcmp(p, key, klen) != 0)
+		return NULL;
+	p += klen;
+
+	/* The mapping isn't NUL terminated, so strtod() gets a copy */
+	for (n = 0; p + n < end && n < sizeof(tmp) - 1 &&
+			strchr("0123456789.eE+-", p[n]); n++)
+		tmp[n] = p[n];
+	tmp[n] = '\0';
+
+	*val = strtod(tmp, &e);
+	if (e == tmp)
+		return NULL;
+
+	return p + (e - tmp);
+}
+
+/*
+ * Get the next record.  Returns 1, or 0 at the end of the capture.
+ */
+int replay_next(struct replay *rp, struct replay_rec *rec)
+{
+	const char *p, *end, *nl, *q;
+	double ts, mono;
+
+	while (rp->pos < rp->size) {
+		p = rp->map + rp->pos;
+		nl = memchr(p, '\n', rp->size - rp->pos);
+		end = nl ? nl : rp->map + rp->size;
+		rp->pos = end - rp->map + (nl != NULL);
+
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		while (end > p && (end[-1] == '\r' || end[-1] == ' ' ||
+					end[-1] == '\t'))
+			end--;
+		if (p == end)
+			continue;
+
+		q = scan_time(p, end, "{\"ts\":", &ts);
+		if (q)
+			q = scan_time(q, end, ",\"mono\":", &mono);
+		if (q && (size_t)(end - q) > 9 &&
+				memcmp(q, ",\"line\":", 8) == 0 && end[-1] == '}') {
+			rp->ts = ts;
+			rp->mono = mono;
+			p = q + 8;
+			end--;
+		}
+
+		rec->line = p;
+		rec->len = end - p;
+		rec->ts = rp->ts;
+		rec->mono = rp->mono;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Capture file reader.  A capture is NDJSON with one record per line:
+ *
+ *   {"ts":1539994511.250,"mono":8345.120,"line":{ ...rtl_433 output... }}
+ *
+ * ts is the wall clock time the line was read, mono the
+ * CLOCK_MONOTONIC time, both in seconds.  Plain rtl_433 lines are
+ * accepted too and get the times of the record before them.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+
+struct replay {
+	char *map;
+	size_t size;
+	size_t pos;
+	double ts;
+	double mono;
+};
+
+struct replay_rec {
+	const char *line;	/* not NUL terminated */
+	size_t len;
+	double ts;
+	double mono;
+};
+
+int replay_open(struct replay *rp, const char *path);
+int replay_next(struct replay *rp, struct replay_rec *rec);
+void replay_close(struct replay *rp);
+
+#endif
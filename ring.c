@@ -0,0 +1,253 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Single-producer/single-consumer slot queue.
+ *
+ * A ring owns a pool of fixed size slots and two queues of slot
+ * pointers: 'queue' carries filled slots to the consumer and 'spare'
+ * carries them back empty.  The producer takes a slot with ring_get(),
+ * fills it in place and hands it over with ring_put().  The consumer
+ * gets it with ring_take() or ring_poll() and gives it back with
+ * ring_release().  Nothing is copied and nothing is allocated after
+ * ring_init().
+ *
+ * When every slot is queued the policy decides what the producer does.
+ * RING_BLOCK waits for the consumer to release one.  RING_DROP_OLDEST
+ * pulls the oldest filled slot back out of the queue and reuses it.
+ * That makes the queue tail the one index both sides can move, so it
+ * is advanced with a compare-and-swap; everything else has a single
+ * writer.
+ *
+ * Waiting uses semaphores, but a side only posts when the other has
+ * said it is about to sleep, so the fast path is just atomics.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "ring.h"
+
+int ring_init(struct ring *r, unsigned int slots, size_t slot_size,
+		enum ring_policy policy)
+{
+	uint32_t size, i;
+
+	if (slots < 2)
+		slots = 2;
+
+	/* Both queues can hold every slot, so neither can overflow */
+	for (size = 2; size < slots; size <<= 1)
+		;
+
+	r->policy = policy;
+	r->mask = size - 1;
+	r->pool = (char *)calloc(slots, slot_size);
+	r->queue = (void **)calloc(size, sizeof(void *));
+	r->spare = (void **)calloc(size, sizeof(void *));
+	if (r->pool == NULL || r->queue == NULL || r->spare == NULL) {
+		ring_free(r);
+		return -1;
+	}
+
+	for (i = 0; i < slots; i++)
+		r->spare[i] = r->pool + i * slot_size;
+
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->spare_head, slots);
+	atomic_init(&r->spare_tail, 0);
+	atomic_init(&r->consumer_waiting, 0);
+	atomic_init(&r->producer_waiting, 0);
+	sem_init(&r->ready, 0, 0);
+	sem_init(&r->space, 0, 0);
+
+	r->pushed = 0;
+	r->dropped = 0;
+	r->waits = 0;
+	r->max_depth = 0;
+	r->popped = 0;
+
+	return 0;
+}
+
+void ring_free(struct ring *r)
+{
+	if (r->pool) {
+		sem_destroy(&r->ready);
+		sem_destroy(&r->space);
+	}
+	free(r->pool);
+	free(r->queue);
+	free(r->spare);
+	r->pool = NULL;
+	r->queue = NULL;
+	r->spare = NULL;
+}
+
+static void sem_wait_intr(sem_t *sem)
+{
+	while (sem_wait(sem) < 0 && errno == EINTR)
+		;
+}
+
+/*
+ * Take the oldest filled slot off the queue.  Returns NULL if the queue
+ * is empty.  Used by the consumer, and by the producer when dropping.
+ */
+static void *dequeue(struct ring *r)
+{
+	uint32_t t;
+	void *slot;
+
+	t = atomic_load(&r->tail);
+	do {
+		if (t == atomic_load(&r->head))
+			return NULL;
+		slot = r->queue[t & r->mask];
+	} while (!atomic_compare_exchange_weak(&r->tail, &t, t + 1));
+
+	return slot;
+}
+
+static void *get_spare(struct ring *r)
+{
+	uint32_t t = atomic_load_explicit(&r->spare_tail, memory_order_relaxed);
+	void *slot;
+
+	if (t == atomic_load_explicit(&r->spare_head, memory_order_acquire))
+		return NULL;
+
+	slot = r->spare[t & r->mask];
+	atomic_store_explicit(&r->spare_tail, t + 1, memory_order_release);
+
+	return slot;
+}
+
+/*
+ * Get an empty slot to fill.  Never returns NULL: with RING_BLOCK this
+ * waits until the consumer releases a slot, with RING_DROP_OLDEST it
+ * reuses the oldest queued one instead.
+ */
+void *ring_get(struct ring *r)
+{
+	void *slot;
+
+	for (;;) {
+		slot = get_spare(r);
+		if (slot)
+			return slot;
+
+		if (r->policy == RING_DROP_OLDEST) {
+			slot = dequeue(r);
+			if (slot) {
+				r->dropped++;
+				return slot;
+			}
+			/* The consumer holds the rest; it will release one */
+		}
+
+		atomic_store(&r->producer_waiting, 1);
+		slot = get_spare(r);
+		if (slot) {
+			atomic_store(&r->producer_waiting, 0);
+			return slot;
+		}
+		r->waits++;
+		sem_wait_intr(&r->space);
+	}
+}
+
+void ring_put(struct ring *r, void *slot)
+{
+	uint32_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+	uint32_t depth;
+
+	r->queue[h & r->mask] = slot;
+	atomic_store(&r->head, h + 1);	/* ordered before the waiting check */
+
+	r->pushed++;
+	depth = h + 1 - atomic_load_explicit(&r->tail, memory_order_relaxed);
+	if (depth > r->max_depth)
+		r->max_depth = depth;
+
+	if (atomic_exchange(&r->consumer_waiting, 0))
+		sem_post(&r->ready);
+}
+
+/*
+ * Get the next filled slot, or NULL if there is none right now.
+ */
+void *ring_poll(struct ring *r)
+{
+	void *slot;
+
+	slot = dequeue(r);
+	if (slot)
+		r->popped++;
+
+	return slot;
+}
+
+/*
+ * Get the next filled slot, waiting for one if necessary.
+ */
+void *ring_take(struct ring *r)
+{
+	void *slot;
+
+	for (;;) {
+		slot = ring_poll(r);
+		if (slot)
+			return slot;
+
+		atomic_store(&r->consumer_waiting, 1);
+		slot = ring_poll(r);
+		if (slot) {
+			atomic_store(&r->consumer_waiting, 0);
+			return slot;
+		}
+		sem_wait_intr(&r->ready);
+	}
+}
+
+void ring_release(struct ring *r, void *slot)
+{
+	uint32_t h = atomic_load_explicit(&r->spare_head, memory_order_relaxed);
+
+	r->spare[h & r->mask] = slot;
+	atomic_store(&r->spare_head, h + 1);	/* as in ring_put() */
+
+	if (atomic_exchange(&r->producer_waiting, 0))
+		sem_post(&r->space);
+}
+
+/*
+ * The counters are owned by one side each, so the numbers are only
+ * exact once both sides have stopped.
+ */
+void ring_get_stats(struct ring *r, struct ring_stats *stats)
+{
+	stats->pushed = r->pushed;
+	stats->popped = r->popped;
+	stats->dropped = r->dropped;
+	stats->waits = r->waits;
+	stats->depth = atomic_load(&r->head) - atomic_load(&r->tail);
+	stats->max_depth = r->max_depth;
+}
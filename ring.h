@@ -0,0 +1,83 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Bounded single-producer/single-consumer queue of preallocated slots,
+ * used to hand lines and packets from one pipeline stage to the next.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+
+enum ring_policy {
+	RING_BLOCK,		/* producer waits for the consumer */
+	RING_DROP_OLDEST,	/* producer reuses the oldest queued slot */
+};
+
+struct ring_stats {
+	unsigned long pushed;
+	unsigned long popped;
+	unsigned long dropped;	/* queued slots reused by RING_DROP_OLDEST */
+	unsigned long waits;	/* times the producer had to wait */
+	unsigned int depth;
+	unsigned int max_depth;
+};
+
+struct ring {
+	enum ring_policy policy;
+	uint32_t mask;
+	char *pool;
+	void **queue;		/* filled slots, producer to consumer */
+	void **spare;		/* empty slots, consumer to producer */
+	_Atomic uint32_t head;	/* written by the producer */
+	_Atomic uint32_t tail;	/* advanced by the consumer, or a dropping producer */
+	_Atomic uint32_t spare_head;	/* written by the consumer */
+	_Atomic uint32_t spare_tail;	/* written by the producer */
+	atomic_int consumer_waiting;
+	atomic_int producer_waiting;
+	sem_t ready;
+	sem_t space;
+	/* producer side counters */
+	unsigned long pushed, dropped, waits;
+	unsigned int max_depth;
+	/* consumer side counter */
+	unsigned long popped;
+};
+
+int ring_init(struct ring *r, unsigned int slots, size_t slot_size,
+		enum ring_policy policy);
+void ring_free(struct ring *r);
+
+/* Producer */
+void *ring_get(struct ring *r);
+void ring_put(struct ring *r, void *slot);
+
+/* Consumer */
+void *ring_take(struct ring *r);
+void *ring_poll(struct ring *r);
+void ring_release(struct ring *r, void *slot);
+
+void ring_get_stats(struct ring *r, struct ring_stats *stats);
+
+#endif
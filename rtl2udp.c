@@ -27,689 +27,964 @@
 #define _GNU_SOURCE
 
 #include <stdio.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 #include <signal.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <math.h>
-#include <fcntl.h>
 #include <time.h>
-#include <pthread.h>
-#include <sys/ioctl.h>
-#include <linux/i2c-dev.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "cJSON.h"
+#include "ingest.h"
+#include "sampler.h"
+#include "i2c.h"
+#include "i2csched.h"
+#include "predict.h"
+#include "bmp280.h"
+#include "i2csim.h"
+#include "rtl2udp.h"
+#include "wfpacket.h"
+#include "sender.h"
+#include "sensortab.h"
+#include "extract.h"
+#include "arena.h"
+#include "evloop.h"
+#include "pipeline.h"
+#include "vclock.h"
+#include "replay.h"
+#include "record.h"
+#include "decoder.h"
+#include "fieldmap.h"
+
+static void parse_air(const struct rtl_msg *msg, struct air_data *data);
+static void parse_sky(const struct rtl_msg *msg, struct sky_data *data);
+static void publish_air(struct air_data *data);
+static void publish_sky(struct sky_data *sky_data);
+static void parse_tower(const struct rtl_msg *msg, struct air_data *tower);
+static void parse_thermo(const struct rtl_msg *msg, struct air_data *air);
+static void decode_tower(const struct rtl_msg *msg, const struct model *m);
+static void decode_5n1(const struct rtl_msg *msg, const struct model *m);
+static void decode_thermo(const struct rtl_msg *msg, const struct model *m);
+static void publish_tower(struct air_data *tower_data, const char *prefix);
+static void publish_rapid_wind(const struct rtl_msg *msg,
+		struct sensor_state *st, int id);
+static char *time_stamp(void);
 
-struct air_data {
-	double temperature;
-	double humidity;
-	double pressure;
-	double battery;
-	int sensor;
-	int time;
-	int interval;
-};
+int debug = 0;
 
-struct sky_data {
-	double wind_speed;
-	double gust_speed;
-	double wind_direction;
-	double rainfall;
-	double illumination;
-	double battery;
-	int sensor;
-	int time;
-	int interval;
-	int precip_type;
-	double prev_rainfall;
+/*
+ * Supported rtl_433 models.  Older rtl_433 releases used longer model
+ * names; both spellings are listed.  Any sensor that reports a
+ * temperature, and maybe humidity, can be sent as a tower sensor.  Ids
+ * are only unique within a model, so each model has its own serial
+ * number prefix; the 5-in-1's come from its packet types.
+ */
+static const struct decoder decoders[] = {
+	{ "Acurite tower sensor",	decode_tower, "ACU-" },
+	{ "Acurite-Tower",		decode_tower, "ACU-" },
+	{ "Acurite 5n1 sensor",		decode_5n1 },
+	{ "Acurite-5n1",		decode_5n1 },
+	{ "Acurite 606TX Sensor",	decode_thermo, "ACU606-" },
+	{ "Acurite-606TX",		decode_thermo, "ACU606-" },
+	{ "Acurite 609TXC Sensor",	decode_thermo, "ACU609-" },
+	{ "Acurite-609TXC",		decode_thermo, "ACU609-" },
+	{ "Acurite 986 Sensor",		decode_thermo, "ACU986-" },
+	{ "Acurite-986",		decode_thermo, "ACU986-" },
+	{ "Acurite-00275rm",		decode_thermo, "ACU275-" },
+	{ "LaCrosse TX141TH-Bv2 sensor",	decode_thermo, "LAC141-" },
+	{ "LaCrosse-TX141THBv2",	decode_thermo, "LAC141-" },
+	{ "LaCrosse TX35DTH-IT",	decode_thermo, "LAC35-" },
+	{ "LaCrosse-TX35DTHIT",		decode_thermo, "LAC35-" },
+	{ "LaCrosse TX29IT",		decode_thermo, "LAC29-" },
+	{ "LaCrosse-TX29IT",		decode_thermo, "LAC29-" },
+	{ "LaCrosse-TX141Bv3",		decode_thermo, "LAC141B-" },
+	{ "Fine Offset Electronics, WH2 Temperature/Humidity sensor",
+					decode_thermo, "FOWH2-" },
+	{ "Fineoffset-WH2",		decode_thermo, "FOWH2-" },
+	{ "Fineoffset-WH5",		decode_thermo, "FOWH5-" },
+	{ "Fineoffset-WH0290",		decode_thermo, "FOWH290-" },
+	{ "Fineoffset-WH32B",		decode_thermo, "FOWH32B-" },
+	{ "OSv2 THGR122N",		decode_thermo, "OS122-" },
+	{ "Oregon-THGR122N",		decode_thermo, "OS122-" },
+	{ "OSv2 THGR810",		decode_thermo, "OS810-" },
+	{ "Oregon-THGR810",		decode_thermo, "OS810-" },
+	{ "OSv2 THN132N",		decode_thermo, "OS132-" },
+	{ "Oregon-THN132N",		decode_thermo, "OS132-" },
+	{ "Oregon-THGR228N",		decode_thermo, "OS228-" },
+	{ "Oregon-BTHR918N",		decode_thermo, "OS918-" },
 };
 
+#define MAX_INPUTS		8
+#define HUB_STATUS_PERIOD	10	/* seconds */
 
-static int fp_getline(FILE *fp, char *s, int lim);
-static void parse_air(cJSON *msg_json, struct air_data *data);
-static void parse_sky(cJSON *msg_json, struct sky_data *data);
-static void publish_air(struct air_data *data);
-static void publish_sky(struct sky_data *sky_data);
-static void parse_tower(cJSON *msg_json, struct air_data *tower);
-static void publish_tower(struct air_data *tower_data);
-static void send_json(char *packet);
-static void get_pressure(struct air_data *air);
-static void get_lux(struct sky_data *sky);
-static char *time_stamp(void);
+struct input {
+	const char *path;	/* NULL for stdin */
+	struct ingest in;
+	struct ev_source *src;
+};
 
-static double tempc(double tempf) {
-	return round(((tempf  - 32) / 1.8) * 10) / 10;
+static struct input inputs[MAX_INPUTS];
+static int ninputs;
+static struct sensortab sensors;
+static int max_age = SENSOR_MAX_AGE;
+static int sample_period = SAMPLER_PERIOD;
+static int sample_age = SAMPLER_MAX_AGE;
+static time_t start_time;
+static unsigned int hub_seq;
+
+static void handle_line(char *line, size_t len);
+static void input_ready(struct ev_source *src, uint32_t events);
+static int input_open(struct input *inp);
+static void print_stage(const char *name, const struct ring_stats *st);
+static void print_model(const struct model *m);
+static void queue_line(const char *line, size_t len);
+static void replay_run(struct replay *rp, double speed);
+static void usage(const char *prog);
+
+static volatile sig_atomic_t stopped;
+
+static void stop(int sig)
+{
+	stopped = 1;
+	evloop_stop();
 }
 
-static double mph2ms(double mph) {
-	return round((mph * .44704) * 10) / 10;
+/*
+ * The sensor table belongs to the parse thread, so the timers just
+ * queue these to run there.
+ */
+static void evict(void)
+{
+	int n;
+
+	n = sensortab_evict(&sensors, vclock_now(), max_age);
+	if (debug && n)
+		printf("Forgot %d stale sensor(s)\n", n);
 }
 
-static double in2mm(double in) {
-	return round((in * 25.4) * 10) / 10;
+static void hub_status(void)
+{
+	struct wf_packet *pkt = pipeline_packet();
+	time_t now = vclock_now();
+
+	wf_hub_status(pkt, now - start_time, now, hub_seq++);
+	pipeline_publish(pkt);
 }
 
-static int debug = 0;
+static void evict_timer(void *arg)
+{
+	pipeline_call(evict, PIPE_LIVE);
+}
 
-int main (int argc, char **argv)
+static void hub_status_timer(void *arg)
 {
-	char line[512];
-	cJSON *msg_json;
-	const cJSON *field;
-	struct air_data air;
-	struct sky_data sky;
-	struct air_data tower;
-	int i;
-	int seq_no, m_type;
-	char *ts;
-	int seq_56 = 0, seq_49 = 0;
+	pipeline_call(hub_status, PIPE_LIVE);
+}
 
+/* Readings the predictor keeps fresh are left alone */
+static void sample_timer(void *arg)
+{
+	sampler_refresh(sampler_provided(), sample_period / 2);
+}
 
-	air.time = time(NULL);
-	sky.time = time(NULL);
-	tower.time = time(NULL);
+int main (int argc, char **argv)
+{
+	struct stat sb;
+	char *line;
+	size_t len;
+	int i, from_file;
+	const char *replay_path = NULL;
+	const char *output_path = NULL;
+	const char *record_path = NULL;
+	long record_size = RECORD_MAXSIZE;
+	struct bmp280_config bmp_cfg = BMP280_CONFIG_DEFAULT;
+	struct record_stats rstats;
+	double speed = 1;
+	struct replay rp;
+	enum ring_policy policy = RING_DROP_OLDEST;
+	sigset_t sigs;
+	struct sender_stats stats;
+	struct arena_stats astats;
+	struct pipeline_stats pstats;
+	struct sampler_stats sstats;
+	struct i2csched_stats istats;
+	struct predict_stats prstats;
+
+	ninputs = 1;	/* stdin */
 
 	if (argc > 1) {
 		for(i = 1; i < argc; i++) {
 			if (argv[i][0] == '-') { /* An option */
 				switch (argv[i][1]) {
 					case 'd': /* debug */
-						if (++i < argc)
+						if ((i + 1 < argc) && (argv[i + 1][0] != '-'))
 							debug = atoi(argv[++i]);
 						else
 							debug = 1;
 						break;
+					case 'p': /* local sensor sample period */
+						if (i + 1 < argc)
+							sample_period = atoi(argv[++i]);
+						break;
+					case 'e': /* forget sensors after this long */
+						if (i + 1 < argc)
+							max_age = atoi(argv[++i]);
+						break;
+					case 'q': /* full queue policy */
+						if (i + 1 < argc) {
+							i++;
+							if (strcmp(argv[i], "block") == 0)
+								policy = RING_BLOCK;
+							else if (strcmp(argv[i], "drop") == 0)
+								policy = RING_DROP_OLDEST;
+						}
+						break;
+					case 'i': /* additional input FIFO */
+						if ((i + 1 < argc) && (ninputs < MAX_INPUTS))
+							inputs[ninputs++].path = argv[++i];
+						break;
+					case '-': /* long options */
+						if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+							replay_path = argv[++i];
+						else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+							speed = atof(argv[++i]);
+						else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+							output_path = argv[++i];
+						else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+							record_path = argv[++i];
+						else if (strcmp(argv[i], "--record-size") == 0 && i + 1 < argc)
+							record_size = atol(argv[++i]);
+						else if (strcmp(argv[i], "--sensor") == 0 && i + 1 < argc) {
+							if (sampler_add(argv[++i]) < 0) {
+								fprintf(stderr, "Sensors are: ");
+								driver_list(stderr);
+								return 1;
+							}
+						} else if (strcmp(argv[i], "--i2c-sim") == 0 && i + 1 < argc) {
+							if (i2c_sim_attach(argv[++i]) == NULL)
+								return 1;
+						} else if (strcmp(argv[i], "--sample-age") == 0 && i + 1 < argc)
+							sample_age = atoi(argv[++i]);
+						else if (strcmp(argv[i], "--temp-os") == 0 && i + 1 < argc)
+							bmp_cfg.osrs_t = atoi(argv[++i]);
+						else if (strcmp(argv[i], "--pressure-os") == 0 && i + 1 < argc)
+							bmp_cfg.osrs_p = atoi(argv[++i]);
+						else if (strcmp(argv[i], "--iir") == 0 && i + 1 < argc)
+							bmp_cfg.filter = atoi(argv[++i]);
+						else if (strcmp(argv[i], "--bmp-math") == 0 && i + 1 < argc)
+							bmp_cfg.math = strcmp(argv[++i], "double") == 0 ?
+								BMP280_MATH_DOUBLE : BMP280_MATH_INT;
+						else
+							usage(argv[0]);
+						break;
 					default:
-						printf("usage: %s [-d]\n", argv[0]);
+						usage(argv[0]);
 						break;
 				}
 			}
 		}
 	}
 
-	while (fp_getline(stdin, line, 512)) {
-		msg_json = cJSON_Parse(line);
-
-		if (msg_json == NULL) {
-			const char *error_ptr = cJSON_GetErrorPtr();
-			if (error_ptr != NULL) {
-				fprintf(stderr, "Error before: %s\n", error_ptr);
-			}
-			goto skip_message;
+	start_time = time(NULL);
+	if (sample_period < 1)
+		sample_period = 1;
+	if (max_age < 10)
+		max_age = 10;
+	if (sample_age < 0)
+		sample_age = 0;
+
+	/* epoll can't watch a regular file, only stdin is read without it */
+	for (i = 1; i < ninputs; i++) {
+		if (stat(inputs[i].path, &sb) == 0 && !S_ISFIFO(sb.st_mode) &&
+				!S_ISCHR(sb.st_mode)) {
+			fprintf(stderr, "%s: -i takes a FIFO; give a file on stdin "
+					"or with --replay.\n", inputs[i].path);
+			return 1;
 		}
+	}
 
+	if (replay_path) {
+		if (replay_open(&rp, replay_path) < 0)
+			return 1;
+		/* A replay has to see every line to be repeatable */
+		policy = RING_BLOCK;
+		from_file = 0;
+	} else {
+		/*
+		 * A file on stdin is a recording.  epoll can't watch it, and
+		 * there is no point dropping lines from it when a stage falls
+		 * behind.
+		 */
+		from_file = fstat(STDIN_FILENO, &sb) == 0 && S_ISREG(sb.st_mode);
+		if (from_file)
+			policy = RING_BLOCK;
+	}
 
-		field = cJSON_GetObjectItemCaseSensitive(msg_json, "model");
-		if (cJSON_IsString(field) && (field->valuestring != NULL)) {
-			if (strcmp(field->valuestring, "Acurite tower sensor") == 0) {
-				parse_tower(msg_json, &tower);
-				get_pressure(&tower);
-				publish_tower(&tower);
-				goto skip_message;
-			}
-		}
+	/* Only the main thread handles SIGINT and SIGTERM */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
 
-		field = cJSON_GetObjectItemCaseSensitive(msg_json, "sequence_num");
-		if (field)
-			seq_no = field->valueint;
-		else
-			goto skip_message;
+	bmp280_set_config(&bmp_cfg);
 
+	if ((output_path ? sender_open_file(output_path) :
+				sender_open(policy == RING_BLOCK)) < 0)
+		return 1;
 
-		field = cJSON_GetObjectItemCaseSensitive(msg_json, "message_type");
-		if (field)
-			m_type = field->valueint;
-		else
-			goto skip_message;
+	if (arena_init(ARENA_SIZE) < 0) {
+		fprintf(stderr, "Failed to allocate parser arena.\n");
+		return 1;
+	}
 
-		ts = time_stamp();
-		printf("%s Message type %d of %d recieved.\n", ts, m_type, seq_no);
-		free(ts);
+	if (sensortab_init(&sensors, 64) < 0) {
+		fprintf(stderr, "Failed to allocate sensor table.\n");
+		return 1;
+	}
 
+	if (decoder_init(decoders, sizeof(decoders) / sizeof(decoders[0])) < 0)
+		return 1;
 
-		/* Parse info based on message type? */
-		/*
-		 * type 56:
-		 *   "wind_speed_mph" : 3.193,
-		 *   "temperature_F" : 54.500,
-		 *   "humidity" : 53
-		 *   "sequence_num" : 0  [maybe skip any other sequence_num value]
-		 *
-		 * type 49:
-		 *   "wind_speed_mph" : 3.193
-		 *   "wind_dir_deg" : 292.500,
-		 *   "wind_dir" : "WNW"
-		 *   "rainfall_accumulation_inch" : 0.000,
-		 *   raincounter_raw" : 0
-		 */
-		switch (m_type) {
-			case 56:
-				if (seq_no <= seq_56) {
-					parse_air(msg_json, &air);
-					get_pressure(&air);
-					publish_air(&air);
-				}
-				seq_56 = seq_no;
-				break;
-			case 49:
-				if (seq_no <= seq_49) {
-					parse_sky(msg_json, &sky);
-					get_lux(&sky);
-					publish_sky(&sky);
-				}
-				seq_49 = seq_no;
-				break;
-			default:
-				printf("Message type %d\n", field->valueint);
-				printf("%s\n\n", line);
-				break;
-		}
+	if (pipeline_start(policy, handle_line) < 0)
+		return 1;
 
-skip_message:
-		cJSON_Delete(msg_json);
-	}
-	return 0;
-}
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
 
+	if (replay_path) {
+		pthread_sigmask(SIG_UNBLOCK, &sigs, NULL);
+		replay_run(&rp, speed);
+		replay_close(&rp);
+	} else {
+		if (record_path && record_open(record_path,
+					(size_t)(record_size > 0 ? record_size : 1) << 20) < 0)
+			return 1;
 
-/*
- * Parse the sensor data and build a UDP packet that simulates a
- * WF Air packet.
- */
+		if (evloop_init() < 0)
+			return 1;
 
-static void parse_air(cJSON *msg_json, struct air_data *air_data)
-{
-	cJSON *field;
-
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "sensor_id");
-	if (field)
-		air_data->sensor = field->valueint;
-
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "battery");
-	if (field) {
-		if (strcmp(field->valuestring, "OK") == 0)
-			air_data->battery = 3.0;
-		else
-			air_data->battery = 2.0;
-	}
+		/*
+		 * Local sensor readings would make a replay depend on the
+		 * host.  A file on stdin is read without the event loop, so
+		 * readings can't come back through it, and its lines don't
+		 * arrive when the sensors sent them.
+		 */
+		if (sampler_start(!from_file) < 0 ||
+				(!from_file && predict_start() < 0))
+			return 1;
 
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "temperature_F");
-	if (field)
-		air_data->temperature = tempc(field->valuedouble);
+		for (i = 0; i < ninputs; i++) {
+			if (input_open(&inputs[i]) < 0)
+				return 1;
+		}
 
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "humidity");
-	if (field)
-		air_data->humidity = field->valuedouble;
+		sampler_kick();
+		if (!evloop_timer(sample_period * 1000, sample_timer, NULL) ||
+				!evloop_timer(max_age * 100, evict_timer, NULL) ||
+				!evloop_timer(HUB_STATUS_PERIOD * 1000,
+					hub_status_timer, NULL))
+			return 1;
 
-	air_data->interval = time(NULL) - air_data->time;
-	air_data->time = time(NULL);
-}
+		pthread_sigmask(SIG_UNBLOCK, &sigs, NULL);
 
-static void parse_sky(cJSON *msg_json, struct sky_data *sky_data)
-{
-	cJSON *field;
-
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "sensor_id");
-	if (field)
-		sky_data->sensor = field->valueint;
-
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "battery");
-	if (field) {
-		if (strcmp(field->valuestring, "OK") == 0)
-			sky_data->battery = 3.0;
-		else
-			sky_data->battery = 2.0;
+		if (from_file) {
+			while (!stopped &&
+					ingest_getline(&inputs[0].in, &line, &len) > 0)
+				queue_line(line, len);
+		} else {
+			evloop_run();
+		}
 	}
 
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "wind_speed_mph");
-	if (field) {
-		sky_data->wind_speed = mph2ms(field->valuedouble);
+	record_close();
+	pipeline_stop();
+	i2csched_stop();
+	i2c_close_all();
 
-		//if (sky_data->wind_speed > sky_data->gust_speed)
-			sky_data->gust_speed = sky_data->wind_speed;
-	}
+	for (i = 0; i < ninputs; i++)
+		ingest_free(&inputs[i].in);
+	sensortab_free(&sensors);
+	sender_close();
 
-	field = cJSON_GetObjectItemCaseSensitive(msg_json, "wind_dir_deg");
-	if (field)
-		sky_data->wind_direction = field->valuedouble;
+	/* Lost lines are worth knowing about without -d */
+	pipeline_get_stats(&pstats);
+	if (pstats.lines.dropped || pstats.packets.dropped)
+		fprintf(stderr, "Dropped %lu lines and %lu packets while a stage "
+				"fell behind; use -q block for piped files.\n",
+				pstats.lines.dropped, pstats.packets.dropped);
 
-	/*
-	 * TODO: Is this right?
-	 *
-	 * Rainfall may accumulate until there's a sample
-	 * period with no rain.  Thus we may need to track
-	 * the previous value and report only the difference.
-	 */
-	field = cJSON_GetObjectItemCaseSensitive(msg_json,
-			"rainfall_accumulation_inch");
-	if (field) {
-		printf("Rainfall from 5n1 = %f\"\n", field->valuedouble);
-		if (field->valuedouble == 0) {
-			sky_data->prev_rainfall = 0;
-		} else {
-			sky_data->rainfall =
-				in2mm(field->valuedouble - sky_data->prev_rainfall);
-			sky_data->prev_rainfall = field->valuedouble;
+	if (debug) {
+		sender_get_stats(&stats);
+		printf("Sent %lu packets in %lu batches, %lu dropped (%lu full, "
+				"%lu errors)\n", stats.sent, stats.batches,
+				stats.eagain + stats.errors, stats.eagain, stats.errors);
+		arena_get_stats(&astats);
+		printf("Parser arena: %lu messages, peak %zu of %zu bytes, "
+				"%lu heap fallbacks (peak %zu bytes)\n", astats.scopes,
+				astats.peak, astats.size, astats.fallbacks,
+				astats.fallback_peak);
+		print_stage("Parse", &pstats.lines);
+		print_stage("Publish", &pstats.packets);
+		if (pstats.long_lines)
+			printf("%lu lines longer than a queue slot\n",
+					pstats.long_lines);
+		decoder_foreach(print_model);
+		for (i = 0; i < SAMPLE_MAX; i++) {
+			if (!sampler_provides(i))
+				continue;
+			sampler_get_stats(i, &sstats);
+			printf("Sampler %s: %lu hits, %lu misses, %lu shared, "
+					"%lu reads (%lu failed)\n", sample_name(i),
+					sstats.hits, sstats.misses, sstats.shared,
+					sstats.refreshes, sstats.failures);
+		}
+		if (!replay_path) {
+			i2csched_get_stats(&istats);
+			printf("I2C scheduler: %lu readings (%lu failed), %lu "
+					"conversions, %lu overlapped\n", istats.readings,
+					istats.errors, istats.conversions, istats.overlapped);
+			predict_get_stats(&prstats);
+			printf("Predictor: %d sensors learned, %lu of %lu arrivals "
+					"prefetched (mean lead %lu ms), %lu missed\n",
+					prstats.sources, prstats.prefetched, prstats.arrivals,
+					prstats.prefetched ?
+						prstats.lead_ms / prstats.prefetched : 0,
+					prstats.missed);
+		}
+		if (record_path) {
+			record_get_stats(&rstats);
+			printf("Recorded %lu lines, %lu bytes, %lu dropped, %lu write "
+					"errors, %u files rotated\n", rstats.lines, rstats.bytes,
+					rstats.dropped, rstats.errors, rstats.files);
 		}
-		if (sky_data->rainfall > 0)
-			sky_data->precip_type = 1;
 	}
 
-	sky_data->interval = time(NULL) - sky_data->time;
-	sky_data->time = time(NULL);
+	return 0;
 }
 
-static void parse_tower(cJSON *msg_json, struct air_data *tower)
+static void usage(const char *prog)
 {
-	cJSON *field;
-
-	field= cJSON_GetObjectItemCaseSensitive(msg_json, "id");
-	if (field)
-		tower->sensor = field->valueint;
+	printf("usage: %s [-d [level]] [-p seconds] [-e seconds] "
+			"[-q drop|block] [-i fifo]...\n"
+			"       [--record capture [--record-size MB]]\n"
+			"       [--sensor name[:bus[:addr]]]... [--sample-age seconds]\n"
+			"       [--i2c-sim key=value,...]\n"
+			"       [--temp-os 1-16] [--pressure-os 1-16] [--iir 0-16]\n"
+			"       [--bmp-math int|double]\n"
+			"       %s --replay capture [--speed factor] "
+			"[--output file] [-d [level]] [-e seconds]\n"
+			"\n"
+			"A file on stdin or --replay is read in full.  Piped or FIFO input\n"
+			"is live: with -q drop, the default, the oldest queued lines are\n"
+			"dropped when parsing falls behind, so pipe a file with -q block.\n",
+			prog, prog);
+}
 
-	field= cJSON_GetObjectItemCaseSensitive(msg_json, "temperature_C");
-	if (field)
-		tower->temperature = field->valuedouble;
+/*
+ * Feed a capture through the pipeline.  The recorded wall clock times
+ * drive the virtual clock, including when the periodic work runs, and
+ * the recorded monotonic times pace the replay: speed 1 is real time,
+ * 10 is ten times faster and 0 is as fast as possible.
+ */
+static void replay_run(struct replay *rp, double speed)
+{
+	struct replay_rec rec;
+	struct timespec start, due;
+	double offset;
+	time_t now, next_evict = 0, next_status = 0;
+	int evict_period = max_age / 10;
+	int first = 1;
+	double mono0 = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!stopped && replay_next(rp, &rec)) {
+		now = (time_t)rec.ts;
+
+		if (first) {
+			start_time = now;
+			next_evict = now + evict_period;
+			next_status = now + HUB_STATUS_PERIOD;
+			mono0 = rec.mono;
+			first = 0;
+		}
 
-	field= cJSON_GetObjectItemCaseSensitive(msg_json, "humidity");
-	if (field)
-		tower->humidity = field->valuedouble;
+		if (speed > 0 && rec.mono > mono0) {
+			offset = (rec.mono - mono0) / speed;
+			due.tv_sec = start.tv_sec + (time_t)offset;
+			due.tv_nsec = start.tv_nsec +
+				(long)((offset - (time_t)offset) * 1e9);
+			if (due.tv_nsec >= 1000000000L) {
+				due.tv_sec++;
+				due.tv_nsec -= 1000000000L;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+		}
 
-	field= cJSON_GetObjectItemCaseSensitive(msg_json, "battery");
-	if (field)
-		tower->battery = field->valuedouble;
+		/*
+		 * Run the timers that would have fired before this line, but
+		 * only once each across a gap in the capture.
+		 */
+		if (now >= next_evict) {
+			pipeline_call(evict, next_evict);
+			next_evict += ((now - next_evict) / evict_period + 1) *
+				evict_period;
+		}
+		if (now >= next_status) {
+			pipeline_call(hub_status, next_status);
+			next_status += ((now - next_status) / HUB_STATUS_PERIOD + 1) *
+				HUB_STATUS_PERIOD;
+		}
 
-	tower->interval = time(NULL) - tower->time;
-	tower->time = time(NULL);
+		pipeline_line(rec.line, rec.len, now);
+	}
 }
 
-
-static void publish_air(struct air_data *air_data)
+static void print_model(const struct model *m)
 {
-	cJSON *air = NULL;
-	cJSON *obs = NULL;
-	cJSON *ob = NULL;
-	char serial_number[15];
-
-	sprintf(serial_number, "ACUAIR-%d", air_data->sensor);
-	air = cJSON_CreateObject();
-
-	cJSON_AddStringToObject(air, "serial_number", serial_number);
-	cJSON_AddStringToObject(air, "type", "obs_air");
-	cJSON_AddStringToObject(air, "hub_sn", "5n1");
-	obs = cJSON_AddArrayToObject(air, "obs");
-	ob = cJSON_AddArrayToObject(obs, "");
-	cJSON_AddNumberToObject(ob, "", air_data->time); /* Time Epoch */
-	cJSON_AddNumberToObject(ob, "", air_data->pressure);
-	cJSON_AddNumberToObject(ob, "", air_data->temperature);
-	cJSON_AddNumberToObject(ob, "", air_data->humidity);
-	cJSON_AddNumberToObject(ob, "", 0);  /* Lightning Strike Count */
-	cJSON_AddNumberToObject(ob, "", 0);  /* Lightning Strike Avg Distance */
-	cJSON_AddNumberToObject(ob, "", air_data->battery);
-	cJSON_AddNumberToObject(ob, "", air_data->interval);
-	cJSON_AddNumberToObject(air, "firmware_revision", 35);
-
-	send_json(cJSON_Print(air));
-
-	cJSON_Delete(air);
+	if (m->messages)
+		printf("%s: %lu messages%s\n", m->name, m->messages,
+				m->decode ? "" : " (no decoder)");
 }
 
-static void publish_sky(struct sky_data *sky_data)
+static void print_stage(const char *name, const struct ring_stats *st)
 {
-	cJSON *sky = NULL;
-	cJSON *obs = NULL;
-	cJSON *ob = NULL;
-	char serial_number[15];
-
-	sprintf(serial_number, "ACUSKY-%d", sky_data->sensor);
-	sky = cJSON_CreateObject();
-
-	cJSON_AddStringToObject(sky, "serial_number", serial_number);
-	cJSON_AddStringToObject(sky, "type", "obs_sky");
-	cJSON_AddStringToObject(sky, "hub_sn", "5n1");
-	obs = cJSON_AddArrayToObject(sky, "obs");
-	ob = cJSON_AddArrayToObject(obs, "");
-	cJSON_AddNumberToObject(ob, "", sky_data->time); /* Time Epoch */
-	cJSON_AddNumberToObject(ob, "", sky_data->illumination); /* Lux  */
-	cJSON_AddNumberToObject(ob, "", 0);  /* UV */
-	cJSON_AddNumberToObject(ob, "", sky_data->rainfall);
-	cJSON_AddNumberToObject(ob, "", 0);  /* Wind Lull */
-	cJSON_AddNumberToObject(ob, "", sky_data->wind_speed);
-	cJSON_AddNumberToObject(ob, "", sky_data->gust_speed);
-	cJSON_AddNumberToObject(ob, "", sky_data->wind_direction);
-	cJSON_AddNumberToObject(ob, "", sky_data->battery);
-	cJSON_AddNumberToObject(ob, "", sky_data->interval);
-	cJSON_AddNumberToObject(ob, "", 0);  /* Solar Radiation */
-	cJSON_AddNumberToObject(ob, "", 0);  /* Local Day Rain */
-	cJSON_AddNumberToObject(ob, "", sky_data->precip_type);
-	cJSON_AddNumberToObject(ob, "", cJSON_NULL);  /* wind sample interval */
-	cJSON_AddNumberToObject(sky, "firmware_revision", 35);
-
-	send_json(cJSON_Print(sky));
-
-	cJSON_Delete(sky);
+	printf("%s queue: %lu in, %lu out, %lu dropped, %lu waits, "
+			"depth %u (max %u)\n", name, st->pushed, st->popped,
+			st->dropped, st->waits, st->depth, st->max_depth);
 }
 
-static void publish_tower(struct air_data *tower_data)
+/*
+ * Hand a line that was just read to the parse stage, and to the
+ * capture file if one is being recorded.
+ */
+static void queue_line(const char *line, size_t len)
 {
-	cJSON *tower = NULL;
-	cJSON *obs = NULL;
-	cJSON *ob = NULL;
-	char serial_number[15];
-
-	sprintf(serial_number, "ACU-%d", tower_data->sensor);
-	tower = cJSON_CreateObject();
-
-	cJSON_AddStringToObject(tower, "serial_number", serial_number);
-	cJSON_AddStringToObject(tower, "type", "obs_tower");
-	cJSON_AddStringToObject(tower, "hub_sn", "5n1");
-	obs = cJSON_AddArrayToObject(tower, "obs");
-	ob = cJSON_AddArrayToObject(obs, "");
-	cJSON_AddNumberToObject(ob, "", tower_data->time); /* Time Epoch */
-	cJSON_AddNumberToObject(ob, "", tower_data->pressure);
-	cJSON_AddNumberToObject(ob, "", tower_data->temperature);
-	cJSON_AddNumberToObject(ob, "", tower_data->humidity);
-	cJSON_AddNumberToObject(ob, "", 0);  /* Lightning Strike Count */
-	cJSON_AddNumberToObject(ob, "", 0);  /* Lightning Strike Avg Distance */
-	cJSON_AddNumberToObject(ob, "", tower_data->battery);
-	cJSON_AddNumberToObject(ob, "", tower_data->interval);
-	cJSON_AddNumberToObject(tower, "firmware_revision", 35);
-
-	send_json(cJSON_Print(tower));
-
-	cJSON_Delete(tower);
+	record_line(line, len);
+	pipeline_line(line, len, PIPE_LIVE);
 }
 
-static void send_json(char *packet)
+/*
+ * Set up an input for the event loop.  FIFOs are opened read/write so
+ * there is always a writer and the FIFO never reports end of file when
+ * rtl_433 restarts.
+ */
+static int input_open(struct input *inp)
 {
-	int bcast_sock;
-	int enable_broadcast = 1;
-	struct sockaddr_in s;
-	int ret;
-
-	if (debug > 1) {
-		printf("Attempting to broadcast\n");
-		printf("%s\n", packet);
-	}
+	struct stat sb;
+	int fd, flags;
 
-	bcast_sock = socket(AF_INET, SOCK_DGRAM, 0);
-	ret = setsockopt(bcast_sock, SOL_SOCKET, SO_BROADCAST,
-			&enable_broadcast, sizeof(enable_broadcast));
+	if (inp->path == NULL) {
+		fd = STDIN_FILENO;
+	} else {
+		flags = O_RDONLY;
+		if (stat(inp->path, &sb) == 0 && S_ISFIFO(sb.st_mode))
+			flags = O_RDWR;
+		fd = open(inp->path, flags | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			perror(inp->path);
+			return -1;
+		}
+	}
 
-	if (ret) {
-		printf("Failed to create socket\n");
-		goto out;
+	if (ingest_init(&inp->in, fd, INGEST_BUFSIZE) < 0) {
+		fprintf(stderr, "Failed to allocate input buffer.\n");
+		return -1;
 	}
 
-	memset(&s, 0, sizeof(struct sockaddr_in));
-	s.sin_family = AF_INET;
-	s.sin_port = (in_port_t)htons(50222);
-	s.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+	/* A regular file on stdin is read by main() directly */
+	if (fd == STDIN_FILENO && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode))
+		return 0;
 
-	if (sendto(bcast_sock, packet, strlen(packet), 0, (struct sockaddr *)&s,
-				sizeof(struct sockaddr_in)) < 0) {
-		perror("sendto");
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	inp->src = evloop_add(fd, EPOLLIN, input_ready, inp);
+	if (inp->src == NULL)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Input is readable.  Handle a few buffers worth of lines and leave the
+ * rest for the next wakeup so one busy input can't starve the others.
+ */
+static void input_ready(struct ev_source *src, uint32_t events)
+{
+	struct input *inp = (struct input *)src->arg;
+	char *line;
+	size_t len;
+	ssize_t n;
+	int reads;
+
+	for (reads = 0; reads < 4; reads++) {
+		while (ingest_next(&inp->in, &line, &len))
+			queue_line(line, len);
+
+		if (inp->in.eof)
+			break;
+
+		n = ingest_fill(&inp->in);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			perror(inp->path ? inp->path : "stdin");
+			inp->in.eof = 1;
+		}
 	}
 
-out:
-	close(bcast_sock);
+	if (!inp->in.eof)
+		return;
+
+	while (ingest_next(&inp->in, &line, &len))
+		queue_line(line, len);
+
+	evloop_del(src);
+	inp->src = NULL;
+	if (inp->path)
+		close(inp->in.fd);
+	else
+		evloop_stop();	/* rtl_433 went away */
 }
 
-static int fp_getline(FILE *fp, char *s, int lim)
+/*
+ * Decode one line from rtl_433 and publish what it carries.  Runs on
+ * the parse thread.
+ */
+static void handle_line(char *line, size_t len)
 {
-	int c, i;
-	int ws = 0;
-
-	i = 0;
-
-	while (--lim > 0 && (c = fgetc(fp)) != EOF && c != '\n') {
-		if (c != '\r') {
-			if (!ws && ((c == ' ') || (c == '\t'))) {
-				/* skip leading white space */
-			} else {
-				s[i++] = c;
-				ws = 1;
+	cJSON *msg_json;
+	struct rtl_msg msg;
+	struct model *m;
+
+	/*
+	 * Most lines can be picked apart in one pass.  Anything the
+	 * extractor doesn't handle goes through cJSON.
+	 */
+	msg_json = NULL;
+	if (extract_line(line, len, &msg) < 0) {
+		arena_begin();
+		msg_json = cJSON_ParseWithLength(line, len);
+		if (msg_json == NULL) {
+			const char *error_ptr = cJSON_GetErrorPtr();
+			if (error_ptr != NULL) {
+				fprintf(stderr, "Error before: %s\n", error_ptr);
 			}
+			arena_end();
+			return;
 		}
+		extract_from_cjson(msg_json, &msg);
 	}
 
-	s[i] = '\0';
-	if ( c == EOF ) {
-		return (c);
-	} else {
-		return(i);
+	msg.line = line;
+
+	if (msg.present & MSG_MODEL) {
+		m = decoder_lookup(msg.str[FIELD_MODEL].p,
+				msg.str[FIELD_MODEL].len);
+		if (m) {
+			m->messages++;
+			if (m->decode)
+				m->decode(&msg, m);
+		}
 	}
+
+	/* The tree lives in the arena, no need for cJSON_Delete() */
+	if (msg_json)
+		arena_end();
+}
+
+/*
+ * Fill in a local reading from the sampler's cache, which may be stale
+ * but is never waited for.  Until a configured device's first reading
+ * the field is NAN, so it goes out as null rather than as a zero that
+ * a listener would take for a measurement.
+ */
+static void local_reading(enum sample_kind kind, double *value)
+{
+	if (sampler_get(kind, sample_age, value, NULL) < 0 &&
+			sampler_provides(kind))
+		*value = NAN;
 }
 
-static void get_lux(struct sky_data *sky)
+static void decode_tower(const struct rtl_msg *msg, const struct model *m)
 {
-	int i2c;
-	unsigned char reg[1];
-	unsigned char config[2];
-	unsigned char data[24];
-	int ch0, ch1;
-
-	/* Open the I2C bus */
-	i2c = open("/dev/i2c-1", O_RDWR);
-	if (i2c < 0) {
-		fprintf(stderr, "Failed to open I2C bus.\n");
+	struct sensor_state *st;
+	int id = msg_int(msg, FIELD_ID);
+
+	st = sensortab_get(&sensors, sensor_key(m->hash, id), id, vclock_now());
+	if (st == NULL)
 		return;
-	}
 
-	/* Connect to the BMP280 device (address = 0x39) */
-	ioctl(i2c, I2C_SLAVE, 0x39);
+	predict_arrival(sensor_key(m->hash, id), SAMPLE_BIT(SAMPLE_PRESSURE));
+	parse_tower(msg, &st->air);
+	local_reading(SAMPLE_PRESSURE, &st->air.pressure);
+	publish_tower(&st->air, m->prefix);
+}
 
-	/*
-	 * Power on mode
-	 */
-	config[0] = 0x00 | 0x80;
-	config[1] = 0x03;
-	if (write(i2c, config, 2) < 0)
-		fprintf(stderr, "Failed to write control measurement register.\n");
+static void decode_5n1(const struct rtl_msg *msg, const struct model *m)
+{
+	struct sensor_state *st;
+	int id, seq_no, m_type;
+	char *ts;
 
-	/*
-	 * timing register
-	 *  - Mominal integration time = 402ms
-	 */
-	config[0] = 0x01 | 0x80;
-	config[1] = 0x02;
-	if (write(i2c, config, 2) < 0)
-		fprintf(stderr, "Failed to write control measurement register.\n");
+	if (msg->present & MSG_SEQUENCE_NUM)
+		seq_no = msg_int(msg, FIELD_SEQUENCE_NUM);
+	else
+		return;
 
-	sleep(1);
 
-	/* Read Lux data */
-	reg[0] = 0x0C | 0x80;
-	if (write(i2c, reg, 1) < 0)
-		goto end_lux;
+	if (msg->present & MSG_MESSAGE_TYPE)
+		m_type = msg_int(msg, FIELD_MESSAGE_TYPE);
+	else
+		return;
+
+	ts = time_stamp();
+	printf("%s Message type %d of %d recieved.\n", ts, m_type, seq_no);
+	free(ts);
+
+	/* Current rtl_433 calls it id */
+	id = msg_int(msg, (msg->present & MSG_SENSOR_ID) ?
+			FIELD_SENSOR_ID : FIELD_ID);
+	st = sensortab_get(&sensors, sensor_key(m->hash, id), id, vclock_now());
+	if (st == NULL)
+		return;
 
-	if (read(i2c, data, 4) < 0)
-		goto end_lux;
+	/* Both message types carry wind; send it on before anything else */
+	if (m_type == 56 || m_type == 49)
+		publish_rapid_wind(msg, st, id);
 
+	/* Parse info based on message type? */
 	/*
-	 * ch0 is full spectrum (IR + Visible)
-	 * ch1 is IR only
-	 * ch0 - ch1 is visible only
+	 * type 56:
+	 *   "wind_speed_mph" : 3.193,
+	 *   "temperature_F" : 54.500,
+	 *   "humidity" : 53
+	 *   "sequence_num" : 0  [maybe skip any other sequence_num value]
+	 *
+	 * type 49:
+	 *   "wind_speed_mph" : 3.193
+	 *   "wind_dir_deg" : 292.500,
+	 *   "wind_dir" : "WNW"
+	 *   "rainfall_accumulation_inch" : 0.000,
+	 *   raincounter_raw" : 0
 	 */
-	ch0 = data[1] * 256 + data[0];
-	ch1 = data[3] * 256 + data[2];
+	switch (m_type) {
+		case 56:
+			if (seq_no <= st->seq_56) {
+				predict_arrival(sensor_key(m->hash, id),
+						SAMPLE_BIT(SAMPLE_PRESSURE));
+				parse_air(msg, &st->air);
+				local_reading(SAMPLE_PRESSURE, &st->air.pressure);
+				publish_air(&st->air);
+			}
+			st->seq_56 = seq_no;
+			break;
+		case 49:
+			if (seq_no <= st->seq_49) {
+				predict_arrival(sensor_key(m->hash, id),
+						SAMPLE_BIT(SAMPLE_LUX) | SAMPLE_BIT(SAMPLE_UV));
+				parse_sky(msg, &st->sky);
+				local_reading(SAMPLE_LUX, &st->sky.illumination);
+				local_reading(SAMPLE_UV, &st->sky.uv);
+				publish_sky(&st->sky);
+			}
+			st->seq_49 = seq_no;
+			break;
+		default:
+			printf("Message type %d\n", m_type);
+			printf("%s\n\n", msg->line);
+			break;
+	}
+}
 
-	/* Return the visible only reading */
-	sky->illumination = (double)(ch0 - ch1);
+/*
+ * Plain temperature/humidity sensors.  They are published like a tower
+ * sensor.
+ */
+static void decode_thermo(const struct rtl_msg *msg, const struct model *m)
+{
+	struct sensor_state *st;
+	int id = msg_int(msg, FIELD_ID);
 
-	if (debug) {
-		printf("Full : %d lux\n", ch0);
-		printf("IR   : %d lux\n", ch1);
-		printf("VIS  : %d lux\n", (ch0 - ch1));
-	}
+	if (!(msg->present & MSG_ID) ||
+			!(msg->present & (MSG_TEMPERATURE_C | MSG_TEMPERATURE_F)))
+		return;
 
-end_lux:
-	close(i2c);
-	return;
-}
+	st = sensortab_get(&sensors, sensor_key(m->hash, id), id, vclock_now());
+	if (st == NULL)
+		return;
 
-struct bmp_280_calibration {
-	double T1;
-	double T2;
-	double T3;
-	double P1;
-	double P2;
-	double P3;
-	double P4;
-	double P5;
-	double P6;
-	double P7;
-	double P8;
-	double P9;
-};
+	predict_arrival(sensor_key(m->hash, id), SAMPLE_BIT(SAMPLE_PRESSURE));
+	parse_thermo(msg, &st->air);
+	local_reading(SAMPLE_PRESSURE, &st->air.pressure);
+	publish_tower(&st->air, m->prefix);
+}
 
 /*
- * These values are in the device as 16 bit signed shorts
- * Use this macro to convert them to doubles.
+ * Field schemas: where each message field goes in the sensor data and
+ * how it is converted.  Current rtl_433 key names come first so the
+ * legacy ones win when an old release sends both.
  */
-#define COEF(d, i) { \
-	d = (double)(data[i+1] * 256 + data[i]); \
-	if (d > 32767) \
-		d -= 65536; \
+static const struct field_map air_map[] = {
+	FIELD_MAP(ID,			struct air_data, sensor,	INT),
+	FIELD_MAP(SENSOR_ID,		struct air_data, sensor,	INT),
+	FIELD_MAP(BATTERY_OK,		struct air_data, battery,	BATTERY_OK),
+	FIELD_MAP(BATTERY,		struct air_data, battery,	BATTERY),
+	FIELD_MAP(TEMPERATURE_F,	struct air_data, temperature,	TEMPC),
+	FIELD_MAP(HUMIDITY,		struct air_data, humidity,	NONE),
+};
+
+static const struct field_map sky_map[] = {
+	FIELD_MAP(ID,			struct sky_data, sensor,	INT),
+	FIELD_MAP(SENSOR_ID,		struct sky_data, sensor,	INT),
+	FIELD_MAP(BATTERY_OK,		struct sky_data, battery,	BATTERY_OK),
+	FIELD_MAP(BATTERY,		struct sky_data, battery,	BATTERY),
+	FIELD_MAP(WIND_AVG_KMH,		struct sky_data, wind_speed,	KMH2MS),
+	FIELD_MAP(WIND_SPEED_MPH,	struct sky_data, wind_speed,	MPH2MS),
+	FIELD_MAP(WIND_DIR_DEG,		struct sky_data, wind_direction, NONE),
+};
+
+static const struct field_map tower_map[] = {
+	FIELD_MAP(ID,			struct air_data, sensor,	INT),
+	FIELD_MAP(TEMPERATURE_C,	struct air_data, temperature,	NONE),
+	FIELD_MAP(HUMIDITY,		struct air_data, humidity,	NONE),
+	FIELD_MAP(BATTERY_OK,		struct air_data, battery,	BATTERY_OK),
+	FIELD_MAP(BATTERY,		struct air_data, battery,	NONE),
+};
+
+/* Celsius wins over Fahrenheit when a sensor sends both */
+static const struct field_map thermo_map[] = {
+	FIELD_MAP(ID,			struct air_data, sensor,	INT),
+	FIELD_MAP(TEMPERATURE_F,	struct air_data, temperature,	TEMPC),
+	FIELD_MAP(TEMPERATURE_C,	struct air_data, temperature,	NONE),
+	FIELD_MAP(HUMIDITY,		struct air_data, humidity,	NONE),
+	FIELD_MAP(BATTERY_OK,		struct air_data, battery,	BATTERY_OK),
+	FIELD_MAP(BATTERY,		struct air_data, battery,	BATTERY),
+};
+
+static void parse_air(const struct rtl_msg *msg, struct air_data *air_data)
+{
+	fieldmap_apply(msg, air_map, FIELD_MAP_LEN(air_map), air_data);
+
+	air_data->interval = vclock_now() - air_data->time;
+	air_data->time = vclock_now();
 }
 
-static struct bmp_280_calibration *bmp_280 = NULL;
-static void get_pressure(struct air_data *air)
+static void parse_sky(const struct rtl_msg *msg, struct sky_data *sky_data)
 {
-	int i2c;
-	unsigned char reg[1];
-	unsigned char config[2];
-	unsigned char data[24];
-	long pres;
-	long temp;
-	double var1, var2, p, pressure, t_fine;
-
-	/* Open the I2C bus */
-	i2c = open("/dev/i2c-1", O_RDWR);
-	if (i2c < 0) {
-		fprintf(stderr, "Failed to open I2C bus.\n");
-		return;
+	fieldmap_apply(msg, sky_map, FIELD_MAP_LEN(sky_map), sky_data);
+
+	if (msg->present & (MSG_WIND_SPEED_MPH | MSG_WIND_AVG_KMH)) {
+		//if (sky_data->wind_speed > sky_data->gust_speed)
+			sky_data->gust_speed = sky_data->wind_speed;
 	}
 
-	/* Connect to the BMP280 device (address = 0x77) */
-	ioctl(i2c, I2C_SLAVE, 0x77);
-
-	/* Get coefficient data for the sensors, but do it only once */
-	if (!bmp_280) {
-		bmp_280 = (struct bmp_280_calibration *)
-			malloc(sizeof(struct bmp_280_calibration));
-
-		/* Read calibration data */
-		reg[0] = 0x88;
-		if (write(i2c, reg, 1) < 0)
-			goto end_pres;
-
-		if (read(i2c, data, 24) > 0) {
-			/* temperature coefficents */
-			bmp_280->T1 = (double)(data[1] * 256 + data[0]);
-			COEF(bmp_280->T2, 2);
-			COEF(bmp_280->T3, 4);
-
-			/* pressure coefficents */
-			bmp_280->P1 = (double)(data[7] * 256 + data[6]);
-			COEF(bmp_280->P2, 8);
-			COEF(bmp_280->P3, 10);
-			COEF(bmp_280->P4, 12);
-			COEF(bmp_280->P5, 14);
-			COEF(bmp_280->P6, 16);
-			COEF(bmp_280->P7, 18);
-			COEF(bmp_280->P8, 20);
-			COEF(bmp_280->P9, 22);
+	/*
+	 * TODO: Is this right?
+	 *
+	 * Rainfall may accumulate until there's a sample
+	 * period with no rain.  Thus we may need to track
+	 * the previous value and report only the difference.
+	 */
+	if (msg->present & (MSG_RAINFALL_INCH | MSG_RAIN_IN)) {
+		double rain = msg->num[(msg->present & MSG_RAINFALL_INCH) ?
+			FIELD_RAINFALL_INCH : FIELD_RAIN_IN];
+
+		printf("Rainfall from 5n1 = %f\"\n", rain);
+		if (rain == 0) {
+			sky_data->prev_rainfall = 0;
 		} else {
-			free (bmp_280);
-			fprintf(stderr, "Failed to read coefficent data.\n");
-			goto end_pres;
+			sky_data->rainfall = in2mm(rain - sky_data->prev_rainfall);
+			sky_data->prev_rainfall = rain;
 		}
+		if (sky_data->rainfall > 0)
+			sky_data->precip_type = 1;
 	}
 
-	/*
-	 * Control measurement register
-	 *  - norma mode
-	 *  - over sample rate = 1
-	 */
-	config[0] = 0xF4;
-	config[1] = 0x27;
-	if (write(i2c, config, 2) < 0)
-		fprintf(stderr, "Failed to write control measurement register.\n");
+	sky_data->interval = vclock_now() - sky_data->time;
+	sky_data->time = vclock_now();
+}
 
-	/*
-	 * Config register
-	 *  - standby time = 1000ms
-	 */
-	config[0] = 0xF5;
-	config[1] = 0xA0;
-	if (write(i2c, config, 2) < 0)
-		fprintf(stderr, "Failed to write control measurement register.\n");
+static void parse_tower(const struct rtl_msg *msg, struct air_data *tower)
+{
+	fieldmap_apply(msg, tower_map, FIELD_MAP_LEN(tower_map), tower);
 
-	sleep(1);
+	tower->interval = vclock_now() - tower->time;
+	tower->time = vclock_now();
+}
 
-	/* Read temp and pressure data */
-	reg[0] = 0xF7;
-	if (write(i2c, reg, 1) < 0)
-		goto end_pres;
+static void parse_thermo(const struct rtl_msg *msg, struct air_data *air)
+{
+	fieldmap_apply(msg, thermo_map, FIELD_MAP_LEN(thermo_map), air);
 
-	if (read(i2c, data, 8) < 0)
-		goto end_pres;
+	air->interval = vclock_now() - air->time;
+	air->time = vclock_now();
+}
 
-	/* Temperature calculation */
-	temp = (((long)data[3] << 16) | ((long)data[4] << 8) |
-			((long)data[5] & 0xF0)) / 16;
-	/*
-	temp = (((long)data[3] * 65536) | ((long)data[4] * 256) |
-			((long)data[5] & 0xF0)) / 16;
-			*/
 
-	var1 = (((double)temp / 16384) - (bmp_280->T1 / 1024)) * bmp_280->T2;
-	var2 = (((double)temp / 131072) - (bmp_280->T1 / 8192)) *
-		(((double)temp / 131072) - (bmp_280->T1 / 8192)) * bmp_280->T3;
-	t_fine = var1 + var2;
+static void publish_air(struct air_data *air_data)
+{
+	struct wf_packet *pkt = pipeline_packet();
+
+	wf_obs_air(pkt, air_data);
+	pipeline_publish(pkt);
+}
 
-	if (debug)
-		printf("Indoor temp = %.1f F\n", (((t_fine / 5120) * 1.8) + 32));
+static void publish_sky(struct sky_data *sky_data)
+{
+	struct wf_packet *pkt = pipeline_packet();
 
-	/* Pressure calculation */
-	pres = (((long)data[0] << 16) | ((long)data[1] << 8) |
-			((long)data[2] & 0xF0)) / 16;
+	wf_obs_sky(pkt, sky_data);
+	pipeline_publish(pkt);
+}
 
-	var1 = (t_fine / 2) - 64000;
-	var2 = var1 * var1 * (bmp_280->P6 / 32768);
-	var2 = var2 + var1 * (bmp_280->P5 * 2);
-	var2 = (var2 / 4) + (bmp_280->P4 * 65536);
-	var1 = (bmp_280->P3 * var1 * var1 / 524288 + bmp_280->P2 * var1) / 524288;
-	var1 = (1 + var1 / 32768) * bmp_280->P1;
+static void publish_tower(struct air_data *tower_data, const char *prefix)
+{
+	struct wf_packet *pkt = pipeline_packet();
 
-	p = 1048576 - pres;
-	p = (p - (var2 / 4096)) * 6250 / var1;
+	wf_obs_tower(pkt, tower_data, prefix);
+	pipeline_publish(pkt);
+}
 
-	var1 = bmp_280->P9 * p * p / 2147483648;
-	var2 = p * bmp_280->P8 / 32768;
+/*
+ * Every copy of a retransmitted message carries the same wind, so only
+ * the first one within RAPID_WIND_MIN seconds goes out.  Type 56
+ * messages have no direction; the last one from a type 49 is used.
+ */
+static void publish_rapid_wind(const struct rtl_msg *msg,
+		struct sensor_state *st, int id)
+{
+	struct wf_packet *pkt;
+	time_t now = vclock_now();
+	double speed, dir = st->sky.wind_direction;
+
+	if (msg->present & MSG_WIND_SPEED_MPH)
+		speed = mph2ms(msg->num[FIELD_WIND_SPEED_MPH]);
+	else if (msg->present & MSG_WIND_AVG_KMH)
+		speed = kmh2ms(msg->num[FIELD_WIND_AVG_KMH]);
+	else
+		return;
 
-	pressure = (p + (var1 + var2 + bmp_280->P7) / 16) / 100;
-	if (debug)
-		printf("Pressure = %.1f hPa\n", pressure);
+	if (st->rapid_wind && now - st->rapid_wind < RAPID_WIND_MIN)
+		return;
+	st->rapid_wind = now;
 
-	/*
-	 * This is station pressure.  If we want sea level, it will need
-	 * to be converted.
-	 */
-	air->pressure = pressure;
+	if (msg->present & MSG_WIND_DIR_DEG)
+		dir = msg->num[FIELD_WIND_DIR_DEG];
 
-end_pres:
-	close(i2c);
-	return;
+	pkt = pipeline_packet();
+	wf_rapid_wind(pkt, id, now, speed, dir);
+	pipeline_publish(pkt);
 }
 
 static char *time_stamp(void)
 {
-	time_t t = time(NULL);
+	time_t t = vclock_now();
 	struct tm gt;
 	char *ts = (char *)malloc(25);;
 
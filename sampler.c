@@ -0,0 +1,318 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Background sampling of the local sensors.
+ *
+ * The sensors are whatever devices were configured with sampler_add(),
+ * a BMP280 and a TSL2561 on bus 1 if none were.  The I2C scheduler
+ * takes their readings, overlapping the conversions of devices that
+ * are asked at the same time.  Each kind of measurement comes from the
+ * first device that provides it, and the last good value is kept along
+ * with the time it was taken.
+ *
+ * Readings are a small TTL cache with a stale-value contract:
+ * sampler_get() always hands back the cached value at once, however
+ * old it is, and only fails before the first good reading.  If the
+ * value is older than the caller's max age it also asks the scheduler
+ * for a refresh, which the next caller gets.
+ * It is called on the parse path, and readings come back through the
+ * event loop, which may already have stopped, so it never waits for
+ * one.  The predictor refreshes the cache ahead of the messages that
+ * need it.  Only one refresh per device is ever in flight, so callers
+ * that miss at the same time, the predictor and the main loop's sample
+ * timer (sampler_kick()) all share it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sampler.h"
+#include "i2csched.h"
+#include "rtl2udp.h"
+
+#define MAX_DEVICES	8
+
+static const char *default_devices[] = { "bmp280", "tsl2561" };
+
+/* One per device */
+struct sampler {
+	struct device dev;
+	struct i2csched_dev *sd;
+	unsigned long requested;	/* refreshes asked for */
+	unsigned long done;		/* refreshes finished, good or not */
+	struct timespec asked;		/* when the last refresh was asked for */
+	double latency_ms;		/* smoothed, asked to finished */
+};
+
+/* One per kind of measurement */
+struct cached {
+	struct sampler *src;		/* NULL if no device provides it */
+	double value;
+	time_t time;			/* 0 until the first good reading */
+	struct sampler_stats stats;
+};
+
+static struct sampler samplers[MAX_DEVICES];
+static int nsamplers;
+static struct cached cache[SAMPLE_MAX];
+static int started;
+
+/* Protects everything above once the threads are running */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* A device's reading came back from the scheduler */
+static void reading_done(struct device *dev, int ret, const struct reading *r,
+		void *arg)
+{
+	struct sampler *smp = (struct sampler *)arg;
+	struct timespec now;
+	double ms;
+	int k;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - smp->asked.tv_sec) * 1e3 +
+		(now.tv_nsec - smp->asked.tv_nsec) / 1e6;
+
+	pthread_mutex_lock(&lock);
+	if (ret == 0)
+		smp->latency_ms = smp->latency_ms ?
+			smp->latency_ms + (ms - smp->latency_ms) / 4 : ms;
+	for (k = 0; k < SAMPLE_MAX; k++) {
+		if (cache[k].src != smp)
+			continue;
+		cache[k].stats.refreshes++;
+		if (ret == 0 && (r->present & SAMPLE_BIT(k))) {
+			cache[k].value = r->value[k];
+			cache[k].time = time(NULL);
+		} else {
+			cache[k].stats.failures++;
+		}
+	}
+	smp->done = smp->requested;
+	pthread_mutex_unlock(&lock);
+
+	if (ret < 0 && debug)
+		fprintf(stderr, "Failed to sample %s.\n", dev->drv->name);
+}
+
+/*
+ * Add a device, given as name[:bus[:address]].  Call before
+ * sampler_start().
+ */
+int sampler_add(const char *spec)
+{
+	if (nsamplers == MAX_DEVICES) {
+		fprintf(stderr, "Too many sensors.\n");
+		return -1;
+	}
+	if (device_parse(&samplers[nsamplers].dev, spec) < 0)
+		return -1;
+	nsamplers++;
+
+	return 0;
+}
+
+/*
+ * Hand the devices to the I2C scheduler.  With use_evloop readings
+ * come back through the event loop, which must have been initialised.
+ */
+int sampler_start(int use_evloop)
+{
+	struct sampler *smp;
+	unsigned int i;
+	int k;
+
+	if (nsamplers == 0) {
+		for (i = 0; i < sizeof(default_devices) / sizeof(default_devices[0]); i++) {
+			if (sampler_add(default_devices[i]) < 0)
+				return -1;
+		}
+	}
+
+	for (i = 0; i < (unsigned int)nsamplers; i++) {
+		smp = &samplers[i];
+		for (k = 0; k < SAMPLE_MAX; k++) {
+			if (!cache[k].src && (smp->dev.drv->provides & SAMPLE_BIT(k)))
+				cache[k].src = smp;
+		}
+		if (debug)
+			printf("Sensor %s on %s at 0x%02x\n", smp->dev.drv->name,
+					smp->dev.bus->path, smp->dev.addr);
+
+		smp->sd = i2csched_add(&smp->dev, reading_done, smp);
+		if (smp->sd == NULL) {
+			fprintf(stderr, "Too many sensors.\n");
+			return -1;
+		}
+	}
+
+	if (i2csched_start(use_evloop) < 0)
+		return -1;
+
+	started = 1;
+
+	return 0;
+}
+
+/* Ask for a refresh unless one is already under way.  Call locked. */
+static void request(struct sampler *smp, struct sampler_stats *stats)
+{
+	if (smp->done == smp->requested) {
+		smp->requested++;
+		clock_gettime(CLOCK_MONOTONIC, &smp->asked);
+		i2csched_request(smp->sd);
+	} else if (stats) {
+		stats->shared++;
+	}
+}
+
+/*
+ * Ask every device for a new reading, without waiting for it.
+ */
+void sampler_kick(void)
+{
+	int i;
+
+	if (!started)
+		return;
+
+	pthread_mutex_lock(&lock);
+	for (i = 0; i < nsamplers; i++)
+		request(&samplers[i], NULL);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Ask for new readings of kinds that are older than max_age seconds,
+ * or of all of them if max_age is negative, without waiting.
+ */
+void sampler_refresh(unsigned int kinds, int max_age)
+{
+	time_t now = time(NULL);
+	int k;
+
+	if (!started)
+		return;
+
+	pthread_mutex_lock(&lock);
+	for (k = 0; k < SAMPLE_MAX; k++) {
+		if (!(kinds & SAMPLE_BIT(k)) || !cache[k].src)
+			continue;
+		if (max_age >= 0 && cache[k].time && now - cache[k].time <= max_age)
+			continue;
+		request(cache[k].src, NULL);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * How long a refresh of kinds takes, from asking to the reading being
+ * cached: the slowest device's recent average, or its conversion time
+ * until it has been read.
+ */
+long sampler_latency_ms(unsigned int kinds)
+{
+	struct sampler *smp;
+	double ms, worst = 0;
+	int k;
+
+	pthread_mutex_lock(&lock);
+	for (k = 0; k < SAMPLE_MAX; k++) {
+		smp = cache[k].src;
+		if (!(kinds & SAMPLE_BIT(k)) || !smp)
+			continue;
+		ms = smp->latency_ms ? smp->latency_ms :
+			smp->dev.drv->conversion_us(&smp->dev) / 1e3;
+		if (ms > worst)
+			worst = ms;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return (long)(worst + 0.5);
+}
+
+/*
+ * Copy the cached reading, without waiting.  It can be any age: if it
+ * is older than max_age seconds a refresh is started for later callers
+ * and the stale value is still returned, with when saying how old it
+ * is.  Returns -1 and leaves value untouched if there has never been a
+ * good reading.
+ */
+int sampler_get(enum sample_kind kind, int max_age, double *value,
+		time_t *when)
+{
+	struct cached *c = &cache[kind];
+	int ret = -1;
+
+	pthread_mutex_lock(&lock);
+	if (c->time && time(NULL) - c->time <= max_age) {
+		c->stats.hits++;
+	} else {
+		c->stats.misses++;
+		if (started && c->src)
+			request(c->src, &c->stats);
+	}
+
+	if (c->time) {
+		*value = c->value;
+		if (when)
+			*when = c->time;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+/*
+ * Cache counters for one kind of measurement.
+ */
+void sampler_get_stats(enum sample_kind kind, struct sampler_stats *st)
+{
+	pthread_mutex_lock(&lock);
+	*st = cache[kind].stats;
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Whether any configured device measures this.
+ */
+int sampler_provides(enum sample_kind kind)
+{
+	return cache[kind].src != NULL;
+}
+
+/*
+ * SAMPLE_BIT()s of everything the configured devices measure.
+ */
+unsigned int sampler_provided(void)
+{
+	unsigned int kinds = 0;
+	int k;
+
+	for (k = 0; k < SAMPLE_MAX; k++) {
+		if (cache[k].src)
+			kinds |= SAMPLE_BIT(k);
+	}
+
+	return kinds;
+}
@@ -0,0 +1,57 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Background sampling of the local sensors.  The devices are read by
+ * the I2C scheduler and the last reading of each kind is cached.
+ * sampler_get() never waits: it returns the cached reading however old
+ * it is, and a reading older than the caller's max age starts a shared
+ * refresh for later callers.  The caller gets -1 until the first good
+ * reading.
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <time.h>
+#include "driver.h"
+
+#define SAMPLER_PERIOD	60	/* default seconds between samples */
+#define SAMPLER_MAX_AGE	90	/* default age that starts a refresh */
+
+struct sampler_stats {
+	unsigned long hits;		/* fresh enough readings handed out */
+	unsigned long misses;		/* callers given a stale reading or none */
+	unsigned long shared;		/* refreshes already under way */
+	unsigned long refreshes;	/* sensor reads */
+	unsigned long failures;		/* failed sensor reads */
+};
+
+int sampler_add(const char *spec);
+int sampler_start(int use_evloop);
+void sampler_kick(void);
+void sampler_refresh(unsigned int kinds, int max_age);
+long sampler_latency_ms(unsigned int kinds);
+int sampler_get(enum sample_kind kind, int max_age, double *value,
+		time_t *when);
+void sampler_get_stats(enum sample_kind kind, struct sampler_stats *st);
+int sampler_provides(enum sample_kind kind);
+unsigned int sampler_provided(void);
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * UDP sender.
+ *
+ * sender_queue() only records where a packet is; nothing is copied.
+ * The caller keeps the packet untouched until the next sender_flush(),
+ * which sends everything queued in a single sendmmsg() call.  The
+ * socket is non-blocking.  A send error drops the packet and is counted
+ * rather than reported each time.  A full socket buffer drops the rest
+ * of the batch too when running live; when every line has to go out,
+ * as for a file or a replay, the sender waits for room instead.
+ *
+ * For replays the packets can go to a file instead, one per line, so
+ * the output of two runs can be compared.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "sender.h"
+#include "rtl2udp.h"
+
+static int bcast_sock = -1;
+static int out_fd = -1;
+static int wait_full;		/* wait out a full socket buffer */
+static struct sockaddr_in dest;
+static struct iovec iov[SENDER_BATCH];
+static struct mmsghdr msgs[SENDER_BATCH];
+static unsigned int queued;
+static struct sender_stats stats;
+
+/*
+ * Open the broadcast socket.  With wait a full socket buffer holds up
+ * sender_flush() until there is room, rather than dropping packets.
+ */
+int sender_open(int wait)
+{
+	int enable_broadcast = 1;
+	unsigned int i;
+
+	bcast_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			0);
+	if (bcast_sock < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (setsockopt(bcast_sock, SOL_SOCKET, SO_BROADCAST,
+				&enable_broadcast, sizeof(enable_broadcast))) {
+		perror("setsockopt");
+		close(bcast_sock);
+		bcast_sock = -1;
+		return -1;
+	}
+
+	wait_full = wait;
+
+	memset(&dest, 0, sizeof(struct sockaddr_in));
+	dest.sin_family = AF_INET;
+	dest.sin_port = (in_port_t)htons(SENDER_PORT);
+	dest.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < SENDER_BATCH; i++) {
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &dest;
+		msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	}
+
+	return 0;
+}
+
+/*
+ * Write packets to path, one per line, instead of broadcasting them.
+ */
+int sender_open_file(const char *path)
+{
+	out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out_fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+void sender_close(void)
+{
+	sender_flush();
+	if (bcast_sock >= 0)
+		close(bcast_sock);
+	bcast_sock = -1;
+	if (out_fd >= 0)
+		close(out_fd);
+	out_fd = -1;
+}
+
+/*
+ * Queue a packet for the next sender_flush(), which the caller must
+ * make before the packet changes.  Returns the number queued; once it
+ * reaches SENDER_BATCH the caller has to flush before queueing more.
+ */
+int sender_queue(const char *packet, size_t len)
+{
+	if (queued == SENDER_BATCH || len > SENDER_PKTSIZE) {
+		stats.errors++;
+		stats.last_errno = EMSGSIZE;
+		return -1;
+	}
+
+	if (debug > 1) {
+		printf("Attempting to broadcast\n");
+		printf("%.*s\n", (int)len, packet);
+	}
+
+	iov[queued].iov_base = (void *)packet;
+	iov[queued].iov_len = len;
+
+	return ++queued;
+}
+
+static int flush_file(void)
+{
+	static struct iovec lines[2 * SENDER_BATCH];
+	static char nl = '\n';
+	unsigned int i;
+	int sent = 0;
+
+	for (i = 0; i < queued; i++) {
+		lines[2 * i] = iov[i];
+		lines[2 * i + 1].iov_base = &nl;
+		lines[2 * i + 1].iov_len = 1;
+	}
+
+	if (queued) {
+		stats.batches++;
+		if (writev(out_fd, lines, 2 * queued) < 0) {
+			stats.last_errno = errno;
+			stats.errors += queued;
+		} else {
+			sent = queued;
+		}
+	}
+
+	stats.sent += sent;
+	queued = 0;
+
+	return sent;
+}
+
+/*
+ * Send everything queued.  Returns the number of packets sent.
+ */
+int sender_flush(void)
+{
+	struct pollfd pfd;
+	unsigned int done = 0;
+	int sent = 0;
+	int n;
+
+	if (out_fd >= 0)
+		return flush_file();
+
+	if (bcast_sock < 0) {
+		stats.errors += queued;
+		queued = 0;
+		return 0;
+	}
+
+	while (done < queued) {
+		n = sendmmsg(bcast_sock, &msgs[done], queued - done, 0);
+		stats.batches++;
+		if (n > 0) {
+			done += n;
+			sent += n;
+			continue;
+		}
+
+		if (n == 0) {
+			/* Nothing went and errno says nothing about why */
+			stats.errors += queued - done;
+			break;
+		}
+
+		if (errno == EINTR)
+			continue;
+
+		if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_full) {
+			/* Every packet has to go out, wait for room */
+			pfd.fd = bcast_sock;
+			pfd.events = POLLOUT;
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
+		stats.last_errno = errno;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			/* Socket buffer is full, the rest would fail too */
+			stats.eagain += queued - done;
+			break;
+		}
+
+		/* Drop the packet that failed and carry on */
+		stats.errors++;
+		done++;
+	}
+
+	stats.sent += sent;
+	queued = 0;
+
+	return sent;
+}
+
+void sender_get_stats(struct sender_stats *st)
+{
+	*st = stats;
+}
@@ -0,0 +1,49 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * UDP sender.  The broadcast socket is opened once and packets queued
+ * during one pass over the input are sent together with sendmmsg().
+ */
+#ifndef SENDER_H
+#define SENDER_H
+
+#include <stddef.h>
+
+#define SENDER_PORT	50222
+#define SENDER_BATCH	32	/* packets per sendmmsg() call */
+#define SENDER_PKTSIZE	512
+
+struct sender_stats {
+	unsigned long sent;	/* packets handed to the kernel */
+	unsigned long batches;	/* sendmmsg() calls */
+	unsigned long eagain;	/* packets dropped on a full socket buffer */
+	unsigned long errors;	/* packets dropped on other send errors */
+	int last_errno;
+};
+
+int sender_open(int wait);
+int sender_open_file(const char *path);
+void sender_close(void);
+int sender_queue(const char *packet, size_t len);
+int sender_flush(void);
+void sender_get_stats(struct sender_stats *stats);
+
+#endif
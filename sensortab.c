@@ -0,0 +1,223 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Per-sensor state table.
+ *
+ * A key packs a 32 bit hash of the model name with the 32 bit sensor
+ * id.  The table never holds more than 3/4 of its slots, so probe
+ * sequences stay short no matter how many sensors are in range.
+ * Entries are removed with backward shift deletion, which keeps the
+ * table free of tombstones as stale sensors come and go.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensortab.h"
+
+static inline uint32_t slot_of(const struct sensortab *tab, uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+
+	return (uint32_t)key & tab->mask;
+}
+
+/*
+ * FNV-1a hash of the model name.  Zero is reserved so a key is never 0.
+ */
+uint32_t sensor_model_hash(const char *model, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	while (len--) {
+		h ^= (unsigned char)*model++;
+		h *= 16777619u;
+	}
+	if (h == 0)
+		h = 1;
+
+	return h;
+}
+
+/*
+ * Key for a sensor of the model with the given sensor_model_hash().
+ */
+uint64_t sensor_key(uint32_t model_hash, unsigned int id)
+{
+	return ((uint64_t)model_hash << 32) | id;
+}
+
+int sensortab_init(struct sensortab *tab, uint32_t size)
+{
+	uint32_t n = 16;
+
+	while (n < size)
+		n <<= 1;
+
+	tab->keys = (uint64_t *)calloc(n, sizeof(uint64_t));
+	tab->states = (struct sensor_state *)
+		calloc(n, sizeof(struct sensor_state));
+	if (tab->keys == NULL || tab->states == NULL) {
+		free(tab->keys);
+		free(tab->states);
+		return -1;
+	}
+
+	tab->mask = n - 1;
+	tab->count = 0;
+	return 0;
+}
+
+void sensortab_free(struct sensortab *tab)
+{
+	free(tab->keys);
+	free(tab->states);
+	tab->keys = NULL;
+	tab->states = NULL;
+	tab->mask = 0;
+	tab->count = 0;
+}
+
+static int sensortab_grow(struct sensortab *tab)
+{
+	struct sensortab bigger;
+	uint32_t i, s;
+
+	if (sensortab_init(&bigger, (tab->mask + 1) * 2) < 0)
+		return -1;
+
+	for (i = 0; i <= tab->mask; i++) {
+		if (tab->keys[i] == 0)
+			continue;
+		s = slot_of(&bigger, tab->keys[i]);
+		while (bigger.keys[s])
+			s = (s + 1) & bigger.mask;
+		bigger.keys[s] = tab->keys[i];
+		bigger.states[s] = tab->states[i];
+	}
+	bigger.count = tab->count;
+
+	sensortab_free(tab);
+	*tab = bigger;
+	return 0;
+}
+
+struct sensor_state *sensortab_lookup(struct sensortab *tab, uint64_t key)
+{
+	uint32_t s = slot_of(tab, key);
+
+	while (tab->keys[s]) {
+		if (tab->keys[s] == key)
+			return &tab->states[s];
+		s = (s + 1) & tab->mask;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find the state of a sensor, creating it on first sight.  Returns
+ * NULL only if the table could not grow.
+ */
+struct sensor_state *sensortab_get(struct sensortab *tab, uint64_t key,
+		unsigned int id, time_t now)
+{
+	struct sensor_state *st;
+	uint32_t s;
+
+	st = sensortab_lookup(tab, key);
+	if (st) {
+		st->last_seen = now;
+		return st;
+	}
+
+	if ((tab->count + 1) * 4 > (tab->mask + 1) * 3) {
+		if (sensortab_grow(tab) < 0)
+			return NULL;
+	}
+
+	s = slot_of(tab, key);
+	while (tab->keys[s])
+		s = (s + 1) & tab->mask;
+
+	tab->keys[s] = key;
+	tab->count++;
+
+	st = &tab->states[s];
+	memset(st, 0, sizeof(struct sensor_state));
+	st->last_seen = now;
+	st->air.sensor = id;
+	st->air.time = now;
+	st->sky.sensor = id;
+	st->sky.time = now;
+
+	return st;
+}
+
+/*
+ * Remove slot s and shift following entries of the same probe run
+ * back into the hole.
+ */
+static void sensortab_remove(struct sensortab *tab, uint32_t s)
+{
+	uint32_t next, home;
+
+	for (;;) {
+		tab->keys[s] = 0;
+		next = s;
+		for (;;) {
+			next = (next + 1) & tab->mask;
+			if (tab->keys[next] == 0)
+				return;
+			home = slot_of(tab, tab->keys[next]);
+			/* Can the entry at next move back to s? */
+			if (((next - home) & tab->mask) >= ((next - s) & tab->mask))
+				break;
+		}
+		tab->keys[s] = tab->keys[next];
+		tab->states[s] = tab->states[next];
+		s = next;
+	}
+}
+
+/*
+ * Drop every sensor not heard from in max_age seconds.  Returns the
+ * number of entries removed.
+ */
+int sensortab_evict(struct sensortab *tab, time_t now, int max_age)
+{
+	uint32_t s = 0;
+	int removed = 0;
+
+	while (s <= tab->mask) {
+		if (tab->keys[s] && (now - tab->states[s].last_seen > max_age)) {
+			sensortab_remove(tab, s);
+			tab->count--;
+			removed++;
+			/* Slot s may now hold a shifted entry, look again */
+			continue;
+		}
+		s++;
+	}
+
+	return removed;
+}
@@ -0,0 +1,65 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Per-sensor state, keyed by rtl_433 model and sensor id.
+ */
+#ifndef SENSORTAB_H
+#define SENSORTAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "rtl2udp.h"
+
+#define SENSOR_MAX_AGE	900	/* seconds without a message before eviction */
+#define RAPID_WIND_MIN	2	/* seconds between rapid_wind packets */
+
+struct sensor_state {
+	time_t last_seen;
+	int seq_56;		/* last 5-in-1 sequence numbers */
+	int seq_49;
+	time_t rapid_wind;	/* when the last rapid_wind went out */
+	struct air_data air;	/* 5-in-1 type 56 and tower data */
+	struct sky_data sky;	/* 5-in-1 type 49 data, incl. rain state */
+};
+
+/*
+ * Open addressing with linear probing.  The keys are kept in their own
+ * array so a probe sequence only walks over 8 byte entries; the much
+ * larger state is touched once the slot is found.
+ */
+struct sensortab {
+	uint64_t *keys;		/* 0 marks an empty slot */
+	struct sensor_state *states;
+	uint32_t mask;		/* slot count - 1, a power of 2 */
+	uint32_t count;
+};
+
+uint32_t sensor_model_hash(const char *model, size_t len);
+uint64_t sensor_key(uint32_t model_hash, unsigned int id);
+int sensortab_init(struct sensortab *tab, uint32_t size);
+void sensortab_free(struct sensortab *tab);
+struct sensor_state *sensortab_lookup(struct sensortab *tab, uint64_t key);
+struct sensor_state *sensortab_get(struct sensortab *tab, uint64_t key,
+		unsigned int id, time_t now);
+int sensortab_evict(struct sensortab *tab, time_t now, int max_age);
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Silicon Labs SI1145 UV index sensor.
+ *
+ * The chip works out the UV index itself from its visible and IR
+ * channels once given the UCOEF calibration values from the datasheet.
+ * It is left in forced mode: each reading is an ALS_FORCE command and
+ * a read of the UV index registers.  Commands are acknowledged through
+ * the RESPONSE register, which has bit 7 set on an error.
+ */
+#include <stdio.h>
+#include "driver.h"
+#include "rtl2udp.h"
+
+#define SI1145_ADDR	0x60
+
+#define REG_PART_ID	0x00
+#define REG_HW_KEY	0x07
+#define REG_UCOEF0	0x13
+#define REG_PARAM_WR	0x17
+#define REG_COMMAND	0x18
+#define REG_RESPONSE	0x20
+#define REG_UVINDEX0	0x2C
+
+#define PART_ID		0x45
+#define HW_KEY		0x17
+
+#define CMD_NOP		0x00
+#define CMD_RESET	0x01
+#define CMD_ALS_FORCE	0x06
+#define CMD_PARAM_SET	0xA0
+
+#define PARAM_CHLIST	0x01
+#define CHLIST_UV	0x80
+#define CHLIST_ALS_IR	0x20
+#define CHLIST_ALS_VIS	0x10
+
+#define RESPONSE_ERROR	0x80
+
+/*
+ * A forced ALS conversion of the three channels takes a few hundred
+ * microseconds at the default ADC settings; allow plenty.
+ */
+#define CONVERSION_US	10000
+#define RESET_US	10000
+
+static int si_probe(struct device *dev)
+{
+	uint8_t id;
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_PART_ID, &id, 1) < 0)
+		return -1;
+	if (id != PART_ID) {
+		fprintf(stderr, "No si1145 at 0x%02x (part id 0x%02x).\n",
+				dev->addr, id);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Run a command and check the chip took it */
+static int command(struct device *dev, uint8_t cmd)
+{
+	uint8_t response;
+
+	if (i2c_write_reg(dev->bus, dev->addr, REG_COMMAND, cmd) < 0 ||
+			i2c_read_reg(dev->bus, dev->addr, REG_RESPONSE,
+				&response, 1) < 0)
+		return -1;
+
+	if (response & RESPONSE_ERROR) {
+		fprintf(stderr, "si1145 command 0x%02x failed (0x%02x).\n",
+				cmd, response);
+		i2c_write_reg(dev->bus, dev->addr, REG_COMMAND, CMD_NOP);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int si_init(struct device *dev)
+{
+	static const uint8_t ucoef[] = {
+		REG_UCOEF0, 0x7B, 0x6B, 0x01, 0x00,
+	};
+
+	if (i2c_write_reg(dev->bus, dev->addr, REG_COMMAND, CMD_RESET) < 0)
+		return -1;
+	driver_sleep(RESET_US);
+
+	if (i2c_write_reg(dev->bus, dev->addr, REG_HW_KEY, HW_KEY) < 0 ||
+			i2c_write(dev->bus, dev->addr, ucoef, sizeof(ucoef)) < 0 ||
+			i2c_write_reg(dev->bus, dev->addr, REG_PARAM_WR,
+				CHLIST_UV | CHLIST_ALS_IR | CHLIST_ALS_VIS) < 0)
+		return -1;
+
+	return command(dev, CMD_PARAM_SET | PARAM_CHLIST);
+}
+
+static unsigned int si_conversion_us(const struct device *dev)
+{
+	return CONVERSION_US;
+}
+
+static int si_start(struct device *dev)
+{
+	return command(dev, CMD_ALS_FORCE);
+}
+
+static int si_read(struct device *dev, struct reading *r)
+{
+	uint8_t data[2], response;
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_RESPONSE, &response, 1) < 0)
+		return -1;
+	if (response & RESPONSE_ERROR) {
+		fprintf(stderr, "si1145 measurement failed (0x%02x).\n",
+				response);
+		return -1;
+	}
+
+	if (i2c_read_reg(dev->bus, dev->addr, REG_UVINDEX0, data, 2) < 0)
+		return -1;
+
+	/* UV index times 100, little endian */
+	r->value[SAMPLE_UV] = (data[1] << 8 | data[0]) / 100.0;
+	r->present |= SAMPLE_BIT(SAMPLE_UV);
+
+	if (debug)
+		printf("UV index: %.2f\n", r->value[SAMPLE_UV]);
+
+	return 0;
+}
+
+const struct driver si1145_driver = {
+	.name = "si1145",
+	.addr = SI1145_ADDR,
+	.provides = SAMPLE_BIT(SAMPLE_UV),
+	.priv_size = 0,
+	.probe = si_probe,
+	.init = si_init,
+	.start = si_start,
+	.conversion_us = si_conversion_us,
+	.read = si_read,
+	.min_period_us = si_conversion_us,
+};
@@ -0,0 +1,321 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * TSL2561 driver.
+ *
+ * The sensor has two gains (1x, 16x) and three integration times
+ * (13.7, 101 and 402 ms).  Rather than always integrating for 402 ms,
+ * each reading picks the fastest setting that the previous reading
+ * says will still give a useful number of counts without clipping, so
+ * daylight is a 13.7 ms sample and only dusk and night need the long
+ * ones.  A reading that clipped, or came out too dim to be useful at
+ * a less sensitive setting, asks to be taken again straight away with
+ * the better setting.  The package, which picks the lux coefficients,
+ * comes from the ID register.
+ *
+ * Lux is the datasheet's integer CalculateLux with its piecewise
+ * coefficients for the T/FN/CL or CS package.
+ */
+#include <stdio.h>
+#include "tsl2561.h"
+#include "driver.h"
+#include "rtl2udp.h"
+
+#define CMD		0x80	/* command register select */
+#define REG_CONTROL	0x00
+#define REG_TIMING	0x01
+#define REG_ID		0x0A
+#define REG_DATA0	0x0C	/* ch0 low, ch0 high, ch1 low, ch1 high */
+
+#define POWER_ON	0x03
+#define POWER_OFF	0x00
+#define TIMING_GAIN16	0x10
+
+#define PARTNO_CS	0x1
+#define PARTNO_T	0x5
+
+#define MIN_COUNTS	1000	/* ch0 counts worth having, 0.1% steps */
+#define MAX_TRIES	3
+
+#define LUX_SCALE	14	/* scale by 2^14 */
+#define RATIO_SCALE	9	/* scale ratio by 2^9 */
+#define CH_SCALE	10	/* scale channel values by 2^10 */
+#define CHSCALE_TINT0	0x7517	/* 322/11 * 2^CH_SCALE */
+#define CHSCALE_TINT1	0x0FE7	/* 322/81 * 2^CH_SCALE */
+
+static const struct {
+	unsigned int us;	/* time to wait for a conversion */
+	unsigned int units;	/* relative sensitivity, 402 ms is 322 */
+	unsigned int clip;	/* counts at or above this are clipped */
+} integ_info[] = {
+	[TSL2561_13MS] = { 14500, 11, 4900 },
+	[TSL2561_101MS] = { 105000, 81, 36000 },
+	[TSL2561_402MS] = { 406000, 322, 65000 },
+};
+
+/* Settings in the order they are tried: fastest first, then most gain */
+static const struct {
+	uint8_t integ;
+	uint8_t gain16;
+} levels[] = {
+	{ TSL2561_13MS, 1 },
+	{ TSL2561_13MS, 0 },
+	{ TSL2561_101MS, 1 },
+	{ TSL2561_101MS, 0 },
+	{ TSL2561_402MS, 1 },
+	{ TSL2561_402MS, 0 },
+};
+
+#define NLEVELS		(int)(sizeof(levels) / sizeof(levels[0]))
+#define LEAST_SENSITIVE	1	/* 1x, 13.7 ms */
+
+/* Breakpoints of the ch1/ch0 ratio and the coefficients below each */
+struct lux_coef {
+	unsigned int k;
+	unsigned int b;
+	unsigned int m;
+};
+
+static const struct lux_coef coef_t[] = {
+	{ 0x0040, 0x01f2, 0x01be },
+	{ 0x0080, 0x0214, 0x02d1 },
+	{ 0x00c0, 0x023f, 0x037b },
+	{ 0x0100, 0x0270, 0x03fe },
+	{ 0x0138, 0x016f, 0x01fc },
+	{ 0x019a, 0x00d2, 0x00fb },
+	{ 0x029a, 0x0018, 0x0012 },
+	{ ~0u, 0x0000, 0x0000 },
+};
+
+static const struct lux_coef coef_cs[] = {
+	{ 0x0043, 0x0204, 0x01ad },
+	{ 0x0085, 0x0228, 0x02c1 },
+	{ 0x00c8, 0x0253, 0x0363 },
+	{ 0x010a, 0x0282, 0x03df },
+	{ 0x014d, 0x0177, 0x01dd },
+	{ 0x019a, 0x0101, 0x0127 },
+	{ 0x029a, 0x0037, 0x002b },
+	{ ~0u, 0x0000, 0x0000 },
+};
+
+uint32_t tsl2561_lux(unsigned int ch0, unsigned int ch1, int gain16,
+		enum tsl2561_integ integ, int cs_package)
+{
+	const struct lux_coef *c = cs_package ? coef_cs : coef_t;
+	uint64_t chscale, channel0, channel1, ratio;
+	int64_t temp;
+
+	/* Scale the channels to 16x, 402 ms */
+	switch (integ) {
+	case TSL2561_13MS:
+		chscale = CHSCALE_TINT0;
+		break;
+	case TSL2561_101MS:
+		chscale = CHSCALE_TINT1;
+		break;
+	default:
+		chscale = 1 << CH_SCALE;
+		break;
+	}
+	if (!gain16)
+		chscale <<= 4;
+
+	channel0 = (ch0 * chscale) >> CH_SCALE;
+	channel1 = (ch1 * chscale) >> CH_SCALE;
+
+	ratio = 0;
+	if (channel0 != 0)
+		ratio = (channel1 << (RATIO_SCALE + 1)) / channel0;
+	ratio = (ratio + 1) >> 1;
+
+	while (ratio > c->k)
+		c++;
+
+	temp = (int64_t)(channel0 * c->b) - (int64_t)(channel1 * c->m);
+	if (temp < 0)
+		temp = 0;
+
+	/* Keep three decimals where the datasheet rounds to whole lux */
+	return (uint32_t)((temp * 1000 + (1 << (LUX_SCALE - 1))) >> LUX_SCALE);
+}
+
+/* Counts a setting gets relative to the others */
+static unsigned int sensitivity(int level)
+{
+	return integ_info[levels[level].integ].units << (levels[level].gain16 * 4);
+}
+
+/*
+ * Pick the setting for the next reading from ch0 counts taken at the
+ * current one: the first in levels[] expected to see MIN_COUNTS without
+ * getting near clipping, else the most sensitive one that won't clip.
+ */
+static int next_level(int level, unsigned int ch0)
+{
+	uint64_t expect, best_expect = 0;
+	int i, best = LEAST_SENSITIVE;
+
+	for (i = 0; i < NLEVELS; i++) {
+		expect = (uint64_t)ch0 * sensitivity(i) / sensitivity(level);
+		if (expect >= integ_info[levels[i].integ].clip * 3 / 4)
+			continue;
+		if (expect >= MIN_COUNTS)
+			return i;
+		if (expect > best_expect || (expect == best_expect &&
+					sensitivity(i) > sensitivity(best))) {
+			best_expect = expect;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static int tsl_probe(struct device *dev)
+{
+	struct tsl2561 *tsl = dev->priv;
+	uint8_t id;
+
+	if (i2c_read_reg(dev->bus, dev->addr, CMD | REG_ID, &id, 1) < 0)
+		return -1;
+
+	/* Part number in the top nibble: 1 is the CS package, 5 T/FN/CL */
+	if ((id >> 4) != PARTNO_CS && (id >> 4) != PARTNO_T) {
+		fprintf(stderr, "No tsl2561 at 0x%02x (id 0x%02x).\n",
+				dev->addr, id);
+		return -1;
+	}
+	tsl->cs_package = (id >> 4) == PARTNO_CS;
+
+	return 0;
+}
+
+static int tsl_init(struct device *dev)
+{
+	struct tsl2561 *tsl = dev->priv;
+
+	tsl->level = LEAST_SENSITIVE;
+	tsl->tries = 0;
+
+	/* Powered down between readings */
+	return i2c_write_reg(dev->bus, dev->addr, CMD | REG_CONTROL, POWER_OFF);
+}
+
+static unsigned int tsl_conversion_us(const struct device *dev)
+{
+	const struct tsl2561 *tsl = dev->priv;
+
+	return integ_info[levels[tsl->level].integ].us;
+}
+
+static unsigned int tsl_min_period_us(const struct device *dev)
+{
+	return integ_info[TSL2561_13MS].us;
+}
+
+/* Set the gain and integration time; integration starts at power up */
+static int tsl_start(struct device *dev)
+{
+	struct tsl2561 *tsl = dev->priv;
+	int level = tsl->level;
+
+	if (i2c_write_reg(dev->bus, dev->addr, CMD | REG_TIMING,
+				(levels[level].gain16 ? TIMING_GAIN16 : 0) |
+				levels[level].integ) < 0)
+		return -1;
+
+	return i2c_write_reg(dev->bus, dev->addr, CMD | REG_CONTROL, POWER_ON);
+}
+
+/*
+ * Read the counts, power down and work out the lux.  Asks to be started
+ * again if the reading clipped or was too dim, and fails if it clips
+ * even at the least sensitive setting.
+ */
+static int tsl_read(struct device *dev, struct reading *r)
+{
+	struct tsl2561 *tsl = dev->priv;
+	unsigned int ch0, ch1, clip;
+	int level = tsl->level, next, clipped;
+	uint8_t data[4];
+	int ret;
+
+	ret = i2c_read_reg(dev->bus, dev->addr, CMD | REG_DATA0, data, 4);
+	i2c_write_reg(dev->bus, dev->addr, CMD | REG_CONTROL, POWER_OFF);
+	if (ret < 0)
+		return -1;
+
+	/*
+	 * ch0 is full spectrum (IR + Visible)
+	 * ch1 is IR only
+	 */
+	ch0 = data[1] * 256 + data[0];
+	ch1 = data[3] * 256 + data[2];
+
+	clip = integ_info[levels[level].integ].clip;
+	clipped = ch0 >= clip || ch1 >= clip;
+	next = clipped ? LEAST_SENSITIVE : next_level(level, ch0);
+	tsl->level = next;
+
+	if (debug) {
+		printf("TSL2561 %dx %s: ch0 %u ch1 %u%s\n",
+				levels[level].gain16 ? 16 : 1,
+				levels[level].integ == TSL2561_13MS ? "13.7ms" :
+				levels[level].integ == TSL2561_101MS ? "101ms" :
+				"402ms", ch0, ch1, clipped ? " clipped" : "");
+	}
+
+	/* Take it again if it clipped or was too dim to be useful */
+	if (++tsl->tries < MAX_TRIES && next != level && (clipped ||
+				(ch0 < MIN_COUNTS &&
+				 sensitivity(next) > sensitivity(level)))) {
+		return 1;
+	}
+	tsl->tries = 0;
+
+	if (clipped) {
+		if (debug)
+			fprintf(stderr, "TSL2561 saturated.\n");
+		return -1;
+	}
+
+	r->value[SAMPLE_LUX] = tsl2561_lux(ch0, ch1, levels[level].gain16,
+			levels[level].integ, tsl->cs_package) / 1000.0;
+	r->present |= SAMPLE_BIT(SAMPLE_LUX);
+
+	if (debug)
+		printf("Lux  : %.3f\n", r->value[SAMPLE_LUX]);
+
+	return 0;
+}
+
+const struct driver tsl2561_driver = {
+	.name = "tsl2561",
+	.addr = TSL2561_ADDR,
+	.provides = SAMPLE_BIT(SAMPLE_LUX),
+	.priv_size = sizeof(struct tsl2561),
+	.probe = tsl_probe,
+	.init = tsl_init,
+	.start = tsl_start,
+	.conversion_us = tsl_conversion_us,
+	.read = tsl_read,
+	.min_period_us = tsl_min_period_us,
+};
@@ -0,0 +1,48 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * TAOS TSL2561 light sensor.
+ */
+#ifndef TSL2561_H
+#define TSL2561_H
+
+#include <stdint.h>
+
+#define TSL2561_ADDR	0x39
+
+/* Integration times, the timing register's INTEG field */
+enum tsl2561_integ {
+	TSL2561_13MS,		/* 13.7 ms */
+	TSL2561_101MS,
+	TSL2561_402MS,
+};
+
+struct tsl2561 {
+	int cs_package;		/* chipscale package, else T/FN/CL */
+	int level;		/* current gain/integration setting */
+	int tries;		/* conversions for the reading under way */
+};
+
+/* Datasheet CalculateLux, returning millilux rather than whole lux */
+uint32_t tsl2561_lux(unsigned int ch0, unsigned int ch1, int gain16,
+		enum tsl2561_integ integ, int cs_package);
+
+#endif
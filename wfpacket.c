@@ -0,0 +1,243 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * WeatherFlow packet serializer.
+ *
+ * The packets we send always have the same shape, so the fixed parts
+ * are copied from string templates and only the serial number and the
+ * observation values are formatted.  Numbers go through
+ * cJSON_PrintDouble() so they come out exactly as cJSON would print
+ * them.
+ *
+ * Nothing is allocated; each publisher keeps one wf_packet and reuses
+ * it for every send.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "wfpacket.h"
+
+#define HUB_SN		"5n1"
+#define FIRMWARE	"35"
+
+struct out {
+	char *p;
+	char *end;
+	int overflow;
+};
+
+static void put_raw(struct out *o, const char *s, size_t len)
+{
+	if ((size_t)(o->end - o->p) < len) {
+		o->overflow = 1;
+		return;
+	}
+	memcpy(o->p, s, len);
+	o->p += len;
+}
+
+#define put_str(o, s) put_raw(o, s, sizeof(s) - 1)
+
+static void put_int(struct out *o, long long v)
+{
+	char tmp[24];
+	char *t = tmp + sizeof(tmp);
+	unsigned long long u = (v < 0) ? -(unsigned long long)v : v;
+
+	do {
+		*--t = '0' + (u % 10);
+		u /= 10;
+	} while (u);
+
+	if (v < 0)
+		*--t = '-';
+
+	put_raw(o, t, tmp + sizeof(tmp) - t);
+}
+
+static void put_number(struct out *o, double d)
+{
+	int len;
+
+	len = cJSON_PrintDouble(d, o->p, (size_t)(o->end - o->p) + 1);
+	if (len < 0)
+		o->overflow = 1;
+	else
+		o->p += len;
+}
+
+static void put_header(struct out *o, const char *prefix, size_t plen,
+		int sensor, const char *type, size_t tlen)
+{
+	put_str(o, "{\"serial_number\":\"");
+	put_raw(o, prefix, plen);
+	put_int(o, sensor);
+	put_str(o, "\",\"type\":\"");
+	put_raw(o, type, tlen);
+	put_str(o, "\",\"hub_sn\":\"" HUB_SN "\",\"obs\":[[");
+}
+
+static size_t put_finish(struct out *o, struct wf_packet *pkt)
+{
+	if (o->overflow) {
+		pkt->len = 0;
+	} else {
+		*o->p = '\0';
+		pkt->len = (size_t)(o->p - pkt->buf);
+	}
+
+	return pkt->len;
+}
+
+static size_t put_trailer(struct out *o, struct wf_packet *pkt)
+{
+	put_str(o, "]],\"firmware_revision\":" FIRMWARE "}");
+
+	return put_finish(o, pkt);
+}
+
+static void out_init(struct out *o, struct wf_packet *pkt)
+{
+	o->p = pkt->buf;
+	o->end = pkt->buf + sizeof(pkt->buf) - 1;	/* room for the '\0' */
+	o->overflow = 0;
+}
+
+/*
+ * obs_air and obs_tower share the same observation layout.
+ */
+static size_t put_air(struct wf_packet *pkt, const struct air_data *air,
+		const char *prefix, size_t plen, const char *type, size_t tlen)
+{
+	struct out o;
+
+	out_init(&o, pkt);
+	put_header(&o, prefix, plen, air->sensor, type, tlen);
+	put_int(&o, air->time);			/* Time Epoch */
+	put_str(&o, ",");
+	put_number(&o, air->pressure);
+	put_str(&o, ",");
+	put_number(&o, air->temperature);
+	put_str(&o, ",");
+	put_number(&o, air->humidity);
+	put_str(&o, ",0,0,");			/* Lightning count/distance */
+	put_number(&o, air->battery);
+	put_str(&o, ",");
+	put_int(&o, air->interval);
+
+	return put_trailer(&o, pkt);
+}
+
+size_t wf_obs_air(struct wf_packet *pkt, const struct air_data *air)
+{
+	return put_air(pkt, air, "ACUAIR-", 7, "obs_air", 7);
+}
+
+/*
+ * Tower and thermometer sensors; prefix tells the models apart.
+ */
+size_t wf_obs_tower(struct wf_packet *pkt, const struct air_data *tower,
+		const char *prefix)
+{
+	return put_air(pkt, tower, prefix, strlen(prefix), "obs_tower", 9);
+}
+
+size_t wf_obs_sky(struct wf_packet *pkt, const struct sky_data *sky)
+{
+	struct out o;
+
+	out_init(&o, pkt);
+	put_header(&o, "ACUSKY-", 7, sky->sensor, "obs_sky", 7);
+	put_int(&o, sky->time);			/* Time Epoch */
+	put_str(&o, ",");
+	put_number(&o, sky->illumination);	/* Lux */
+	put_str(&o, ",");
+	put_number(&o, sky->uv);		/* UV */
+	put_str(&o, ",");
+	put_number(&o, sky->rainfall);
+	put_str(&o, ",0,");			/* Wind Lull */
+	put_number(&o, sky->wind_speed);
+	put_str(&o, ",");
+	put_number(&o, sky->gust_speed);
+	put_str(&o, ",");
+	put_number(&o, sky->wind_direction);
+	put_str(&o, ",");
+	put_number(&o, sky->battery);
+	put_str(&o, ",");
+	put_int(&o, sky->interval);
+	put_str(&o, ",0,0,");			/* Solar Radiation, Day Rain */
+	put_int(&o, sky->precip_type);
+	/*
+	 * Wind sample interval.  The cJSON version passed cJSON_NULL as a
+	 * number here, so listeners have always been sent 4; keep it.
+	 */
+	put_str(&o, ",4");
+
+	return put_trailer(&o, pkt);
+}
+
+/*
+ * Wind as soon as it is measured, [time, m/s, degrees].  Everything
+ * around the three numbers is one literal per side of the sensor
+ * number, since this goes out for every wind reading.
+ */
+size_t wf_rapid_wind(struct wf_packet *pkt, int sensor, long time,
+		double speed, double direction)
+{
+	struct out o;
+
+	out_init(&o, pkt);
+	put_str(&o, "{\"serial_number\":\"ACUSKY-");
+	put_int(&o, sensor);
+	put_str(&o, "\",\"type\":\"rapid_wind\",\"hub_sn\":\"" HUB_SN
+			"\",\"ob\":[");
+	put_int(&o, time);
+	put_str(&o, ",");
+	put_number(&o, speed);
+	put_str(&o, ",");
+	put_number(&o, direction);
+	put_str(&o, "]}");
+
+	return put_finish(&o, pkt);
+}
+
+/*
+ * The hub reports its own status every few seconds.  Listeners use it
+ * to notice that the hub is alive even when no sensor is in range.
+ */
+size_t wf_hub_status(struct wf_packet *pkt, long uptime, long timestamp,
+		unsigned int seq)
+{
+	struct out o;
+
+	out_init(&o, pkt);
+	put_str(&o, "{\"serial_number\":\"" HUB_SN "\",\"type\":\"hub_status\","
+			"\"firmware_revision\":\"" FIRMWARE "\",\"uptime\":");
+	put_int(&o, uptime);
+	put_str(&o, ",\"rssi\":0,\"timestamp\":");
+	put_int(&o, timestamp);
+	put_str(&o, ",\"reset_flags\":\"\",\"seq\":");
+	put_int(&o, seq);
+	put_str(&o, "}");
+
+	return put_finish(&o, pkt);
+}
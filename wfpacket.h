@@ -0,0 +1,48 @@
+/*
+ * rtl2udp  Copyright (C) 2018 Robert Paauwe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * WeatherFlow packet serializer.  Writes the compact JSON for the
+ * obs_air, obs_sky, obs_tower, rapid_wind and hub_status layouts
+ * directly into a caller owned buffer, without building a cJSON tree.
+ */
+#ifndef WFPACKET_H
+#define WFPACKET_H
+
+#include <stddef.h>
+#include "rtl2udp.h"
+
+#define WF_PACKET_SIZE	512
+
+struct wf_packet {
+	size_t len;
+	char buf[WF_PACKET_SIZE];
+};
+
+size_t wf_obs_air(struct wf_packet *pkt, const struct air_data *air);
+size_t wf_obs_sky(struct wf_packet *pkt, const struct sky_data *sky);
+size_t wf_obs_tower(struct wf_packet *pkt, const struct air_data *tower,
+		const char *prefix);
+size_t wf_rapid_wind(struct wf_packet *pkt, int sensor, long time,
+		double speed, double direction);
+size_t wf_hub_status(struct wf_packet *pkt, long uptime, long timestamp,
+		unsigned int seq);
+
+#endif